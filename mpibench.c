@@ -9,46 +9,7 @@
 #define MAXH 256   /* maximum h in h-relation */
 #define MEGA 1000000.0
 
-void leastsquares(int h0, int h1, double *t, double *g, double *l) {
-  /* This function computes the parameters g and l of the
-     linear function T(h)= g*h+l that best fits
-     the data points (h,t[h]) with h0 <= h <= h1. */
-
-  double nh, sumt, sumth, sumh, sumhh, a;
-  int h;
-
-  nh = h1 - h0 + 1;
-  /* Compute sums:
-      sumt  =  sum of t[h] over h0 <= h <= h1
-      sumth =         t[h]*h
-      sumh  =         h
-      sumhh =         h*h     */
-  sumt = sumth = 0.0;
-  for (h = h0; h <= h1; h++) {
-    sumt += t[h];
-    sumth += t[h] * h;
-  }
-  sumh = (h1 * h1 - h0 * h0 + h1 + h0) / 2;
-  sumhh = (h1 * (h1 + 1) * (2 * h1 + 1) - (h0 - 1) * h0 * (2 * h0 - 1)) / 6;
-
-  /* Solve      nh*l +  sumh*g =  sumt
-              sumh*l + sumhh*g = sumth */
-  if (fabs(nh) > fabs(sumh)) {
-    a = sumh / nh;
-    /* subtract a times first eqn from second eqn */
-    *g = (sumth - a * sumt) / (sumhh - a * sumh);
-    *l = (sumt - sumh * *g) / nh;
-  } else {
-    a = nh / sumh;
-    /* subtract a times second eqn from first eqn */
-    *g = (sumt - a * sumth) / (sumh - a * sumhh);
-    *l = (sumth - sumhh * *g) / sumh;
-  }
-
-} /* end leastsquares */
-
 int main(int argc, char **argv) {
-  void leastsquares(int h0, int h1, double *t, double *g, double *l);
   int p, s, s1, iter, i, n, h, *Nsend, *Nrecv, *Offset_send, *Offset_recv;
   double alpha, beta, x[MAXN], y[MAXN], z[MAXN], src[MAXH], dest[MAXH], time0,
       time1, time, *Time, mintime, maxtime, nflops, r, g0, l0, g, l,
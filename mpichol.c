@@ -0,0 +1,184 @@
+#include "mpiedupack.h"
+#include "mpigrid.h"
+
+#define OMPMIN 4096 /* minimum number of operations of a threaded loop */
+
+double **mpichol_alloc(struct mpigrid *grid, int n, int b) {
+  /* This function allocates the local part of the lower triangular
+     part of an n by n matrix, distributed over the M by N grid
+     according to the block-cyclic distribution with b by b blocks.
+     Row i is a[i][j], 0 <= j < nloc(N,t,gindex(M,s,i,b)+1,b), so that
+     it holds the local columns j with global index at most that of
+     the row. The rows are stored one after the other in a[0], so that
+     the matrix can be freed by matfreed. */
+
+  int nloc(int p, int s, int n, int b);
+  int gindex(int p, int s, int i, int b);
+  int M, N, s, t, nlr, i, len;
+  double *pd, **ppd;
+
+  M = grid->M;
+  N = grid->N;
+  s = grid->s;
+  t = grid->t;
+  nlr = nloc(M, s, n, b);
+  if (nlr == 0)
+    return NULL;
+
+  len = 0;
+  for (i = 0; i < nlr; i++)
+    len += nloc(N, t, gindex(M, s, i, b) + 1, b);
+  ppd = (double **)malloc(nlr * sizeof(double *));
+  if (ppd == NULL)
+    MPI_Abort(MPI_COMM_WORLD, -4);
+  pd = vecallocd(len);
+  for (i = 0; i < nlr; i++) {
+    ppd[i] = pd;
+    pd += nloc(N, t, gindex(M, s, i, b) + 1, b);
+  }
+  return ppd;
+
+} /* end mpichol_alloc */
+
+void mpichol(struct mpigrid *grid, int n, int b, double **a) {
+  /* Compute the Cholesky factorisation A = LL^T of an n by n
+     symmetric positive definite matrix A.
+     Processors are numbered in two-dimensional fashion.
+     Program text for P(s,t) = processor s+t*M of the M by N grid,
+     with 0 <= s < M and 0 <= t < N.
+     A is distributed according to the M by N block-cyclic distribution
+     with b by b blocks, as in mpilu. Only the lower triangular part
+     a(i,j), i >= j, is used; on output it contains L.
+     The strictly upper triangular part is not referenced.
+     The local part a must be allocated by mpichol_alloc, which only
+     stores the local elements of the lower triangular part, so that
+     a[i] has nloc(N,t,gindex(M,s,i,b)+1,b) elements and the memory is
+     about half that of LU.
+
+     No pivot search or row swaps are needed. In stage k, the column k
+     of L is broadcast within the processor rows, as lk in mpilu.
+     By symmetry, the row k needed for the update equals column k,
+     so instead of a broadcast of row k, every processor column gathers
+     the elements of column k with a row index it owns as a column index.
+     The diagonal element is carried along in both communications,
+     so that each stage needs only two supersteps with communication,
+     and the whole update costs about n^3/3 flops instead of 2n^3/3.
+  */
+
+  int nloc(int p, int s, int n, int b);
+  int owner(int p, int k, int b);
+  int gindex(int p, int s, int i, int b);
+  void mpigrid_reserve(struct mpigrid *grid, int nlk, int nuk);
+  double *lk, *uk, *send, *recv, akk, d;
+  int M, N, s, t, nlr, nlc, k, i, j, g, q, sk, tk, len, jmax, *cnt, *displ,
+      *pos;
+
+  MPI_Comm row_comm_s, col_comm_t;
+
+  M = grid->M;
+  N = grid->N;
+  s = grid->s;
+  t = grid->t;
+  row_comm_s = grid->row_comm;
+  col_comm_t = grid->col_comm;
+
+  nlr = nloc(M, s, n, b); /* number of local rows */
+  nlc = nloc(N, t, n, b); /* number of local columns */
+
+  /* Use the buffers of the grid for lk and uk */
+  mpigrid_reserve(grid, nlr + 1, nlc);
+  lk = grid->lk;
+  uk = grid->uk;
+  send = vecallocd(nlr + 1);
+  recv = vecallocd(nlc + 1);
+  cnt = vecalloci(M);
+  displ = vecalloci(M);
+  pos = vecalloci(M);
+
+  for (k = 0; k < n; k++) {
+    int kr, kr1, kc, kc1;
+
+    /****** Superstep 0 ******/
+    kr = nloc(M, s, k, b); /* first local row with global index >= k */
+    kr1 = nloc(M, s, k + 1, b);
+    kc = nloc(N, t, k, b);
+    kc1 = nloc(N, t, k + 1, b);
+    sk = owner(M, k, b); /* processor row of row k */
+    tk = owner(N, k, b); /* processor column of column k */
+
+    if (tk == t) {
+      /* Store column k below the diagonal in lk,
+         followed by the diagonal element if I own it */
+      for (i = kr1; i < nlr; i++)
+        lk[i - kr1] = a[i][kc];
+      if (sk == s)
+        lk[nlr - kr1] = a[kr][kc];
+    }
+
+    /****** Superstep 1 ******/
+    /* Broadcast lk to P(s,*) */
+    MPI_Bcast(lk, nlr - kr1 + 1, MPI_DOUBLE, tk, row_comm_s);
+
+    /****** Superstep 2 ******/
+    /* Send the elements L(g,k) with g one of my global column indices,
+       and the diagonal element, to P(*,t) */
+    len = 0;
+    for (i = kr1; i < nlr; i++) {
+      g = gindex(M, s, i, b);
+      if (owner(N, g, b) == t)
+        send[len++] = lk[i - kr1];
+    }
+    if (sk == s)
+      send[len++] = lk[nlr - kr1];
+
+    for (q = 0; q < M; q++)
+      cnt[q] = 0;
+    for (j = kc1; j < nlc; j++)
+      cnt[owner(M, gindex(N, t, j, b), b)]++;
+    cnt[sk]++; /* the diagonal element */
+    displ[0] = 0;
+    for (q = 1; q < M; q++)
+      displ[q] = displ[q - 1] + cnt[q - 1];
+    MPI_Allgatherv(send, len, MPI_DOUBLE, recv, cnt, displ, MPI_DOUBLE,
+                   col_comm_t);
+
+    /* Put the received elements in uk, in the order of my columns */
+    for (q = 0; q < M; q++)
+      pos[q] = displ[q];
+    for (j = kc1; j < nlc; j++) {
+      q = owner(M, gindex(N, t, j, b), b);
+      uk[j - kc1] = recv[pos[q]++];
+    }
+    akk = recv[pos[sk]];
+    if (akk <= 0.0) /* A is not positive definite */
+      MPI_Abort(MPI_COMM_WORLD, -6);
+    d = sqrt(akk);
+
+    /* Compute column k of L */
+    for (i = kr1; i < nlr; i++)
+      lk[i - kr1] /= d;
+    for (j = kc1; j < nlc; j++)
+      uk[j - kc1] /= d;
+    if (tk == t) {
+      for (i = kr1; i < nlr; i++)
+        a[i][kc] = lk[i - kr1];
+      if (sk == s)
+        a[kr][kc] = d;
+    }
+
+    /* Update of the lower triangular part of A, by all threads */
+#pragma omp parallel for private(j, jmax) schedule(dynamic, 16) \
+    if ((double)(nlr - kr1) * (nlc - kc1) > 2 * OMPMIN)
+    for (i = kr1; i < nlr; i++) {
+      jmax = nloc(N, t, gindex(M, s, i, b) + 1, b);
+      for (j = kc1; j < jmax; j++)
+        a[i][j] -= lk[i - kr1] * uk[j - kc1];
+    }
+  }
+  vecfreei(pos);
+  vecfreei(displ);
+  vecfreei(cnt);
+  vecfreed(recv);
+  vecfreed(send);
+
+} /* end mpichol */
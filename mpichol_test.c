@@ -0,0 +1,198 @@
+#include "mpiedupack.h"
+#include "mpigrid.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/*  This is a test program which uses mpichol to compute the Cholesky
+    factorisation A = LL^T of an n by n symmetric positive definite
+    matrix A.
+
+    The input matrix A is defined by: A(i,j) = r(min(i,j),max(i,j))
+    for i != j and A(i,i) = r(i,i) + n, where r(i,j) is a pseudo-random
+    number in [-1,1] computed from the indices. A is strictly
+    diagonally dominant, and hence positive definite, and L is a
+    full lower triangular matrix.
+
+    The matrix is distributed according to the M by N block-cyclic
+    distribution with b by b blocks. For b=1 this is the M by N
+    cyclic distribution. Only the lower triangular part of A is
+    stored, as allocated by mpichol_alloc.
+
+    The time and the computing rate based on n^3/3 flops are printed.
+    For n <= CHECKMAX, L is gathered on P(0,0), which computes and
+    prints the maximum absolute element of A - LL^T.
+*/
+
+#define GIGA 1000000000.0
+#define CHECKMAX 500
+
+double cholmat(int n, int i, int j) {
+  /* Return the element A(i,j) of the test matrix */
+  unsigned int x;
+  int i1, j1;
+
+  i1 = MIN(i, j);
+  j1 = MAX(i, j);
+  x = (unsigned int)i1 * 2654435761u ^ ((unsigned int)j1 * 40503u + 7u);
+  x ^= x >> 13;
+  x *= 0x5bd1e995u;
+  x ^= x >> 15;
+  return (x % 10000) / 5000.0 - 1.0 + (i == j ? n : 0.0);
+
+} /* end cholmat */
+
+int main(int argc, char **argv) {
+
+  int nloc(int p, int s, int n, int b);
+  int gindex(int p, int s, int i, int b);
+  struct mpigrid *mpigrid_create(int M, int N, MPI_Comm comm);
+  void mpigrid_free(struct mpigrid *grid);
+  double **mpichol_alloc(struct mpigrid *grid, int n, int b);
+  void mpichol(struct mpigrid *grid, int n, int b, double **a);
+  double cholmat(int n, int i, int j);
+  int p, pid, provided, M, N, s, t, n, b, nlr, i, j, k, q, sq, tq,
+      iglob, jlen, len, pos, *cnt, *displ;
+  double **a, **L, *buf, time0, time1, nflops, sum, max_error;
+  struct mpigrid *grid;
+
+  /* Only the master thread of each processor communicates */
+  MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+#ifdef _OPENMP
+  if (provided < MPI_THREAD_FUNNELED)
+    omp_set_num_threads(1);
+#endif
+
+  MPI_Comm_size(MPI_COMM_WORLD, &p);
+  MPI_Comm_rank(MPI_COMM_WORLD, &pid);
+
+  if (pid == 0) {
+    printf("Please enter number of processor rows M:\n");
+    scanf("%d", &M);
+    printf("Please enter number of processor columns N:\n");
+    scanf("%d", &N);
+    if (M * N != p)
+      MPI_Abort(MPI_COMM_WORLD, -5);
+    printf("Please enter matrix size n:\n");
+    scanf("%d", &n);
+    printf("Please enter distribution block size b:\n");
+    scanf("%d", &b);
+    if (b < 1)
+      MPI_Abort(MPI_COMM_WORLD, -12);
+  }
+  MPI_Bcast(&M, 1, MPI_INT, 0, MPI_COMM_WORLD);
+  MPI_Bcast(&N, 1, MPI_INT, 0, MPI_COMM_WORLD);
+  MPI_Bcast(&n, 1, MPI_INT, 0, MPI_COMM_WORLD);
+  MPI_Bcast(&b, 1, MPI_INT, 0, MPI_COMM_WORLD);
+
+  /* Create the M by N processor grid, which determines
+     my 2D processor numbering */
+  grid = mpigrid_create(M, N, MPI_COMM_WORLD);
+  s = grid->s; /* 0 <= s < M */
+  t = grid->t; /* 0 <= t < N */
+
+  /* Allocate and initialize matrix */
+  nlr = nloc(M, s, n, b); /* number of local rows */
+  a = mpichol_alloc(grid, n, b);
+
+  if (s == 0 && t == 0) {
+    printf("Cholesky factorisation of %d by %d matrix\n", n, n);
+    if (b > 1) {
+      printf("using the %d by %d block-cyclic distribution", M, N);
+      printf(" with %d by %d blocks\n", b, b);
+    } else {
+      printf("using the %d by %d cyclic distribution\n", M, N);
+    }
+#ifdef _OPENMP
+    printf("with %d threads per processor\n", omp_get_max_threads());
+#endif
+  }
+  for (i = 0; i < nlr; i++) {
+    iglob = gindex(M, s, i, b);
+    for (j = 0; j < nloc(N, t, iglob + 1, b); j++)
+      a[i][j] = cholmat(n, iglob, gindex(N, t, j, b));
+  }
+
+  if (s == 0 && t == 0)
+    printf("Start of Cholesky factorisation\n");
+
+  MPI_Barrier(grid->comm);
+  time0 = MPI_Wtime();
+
+  mpichol(grid, n, b, a);
+
+  MPI_Barrier(grid->comm);
+  time1 = MPI_Wtime();
+
+  if (s == 0 && t == 0) {
+    printf("End of Cholesky factorisation\n");
+    printf("This took only %.6lf seconds.\n", time1 - time0);
+    nflops = n * (double)n * n / 3.0;
+    printf("Computing rate = %.3lf Gflop/s\n",
+           nflops / (GIGA * (time1 - time0)));
+    fflush(stdout);
+  }
+
+  if (n <= CHECKMAX) {
+    /* Gather the local triangles on P(0,0), which has rank 0 */
+    len = 0;
+    for (i = 0; i < nlr; i++)
+      len += nloc(N, t, gindex(M, s, i, b) + 1, b);
+    cnt = vecalloci(p);
+    displ = vecalloci(p);
+    MPI_Gather(&len, 1, MPI_INT, cnt, 1, MPI_INT, 0, grid->comm);
+    if (s == 0 && t == 0) {
+      displ[0] = 0;
+      for (q = 1; q < p; q++)
+        displ[q] = displ[q - 1] + cnt[q - 1];
+      buf = vecallocd(displ[p - 1] + cnt[p - 1]);
+    } else {
+      buf = NULL;
+    }
+    MPI_Gatherv((len > 0 ? a[0] : NULL), len, MPI_DOUBLE, buf, cnt, displ,
+                MPI_DOUBLE, 0, grid->comm);
+
+    if (s == 0 && t == 0) {
+      /* Processor P(sq,tq) has rank sq+tq*M */
+      L = matallocd(n, n);
+      for (i = 0; i < n; i++) {
+        for (j = 0; j < n; j++)
+          L[i][j] = 0.0;
+      }
+      for (q = 0; q < p; q++) {
+        sq = q % M;
+        tq = q / M;
+        pos = displ[q];
+        for (i = 0; i < nloc(M, sq, n, b); i++) {
+          iglob = gindex(M, sq, i, b);
+          jlen = nloc(N, tq, iglob + 1, b);
+          for (j = 0; j < jlen; j++)
+            L[iglob][gindex(N, tq, j, b)] = buf[pos++];
+        }
+      }
+
+      /* Compute the maximum of |A - LL^T| over the lower triangle */
+      max_error = 0.0;
+      for (i = 0; i < n; i++) {
+        for (j = 0; j <= i; j++) {
+          sum = 0.0;
+          for (k = 0; k <= j; k++)
+            sum += L[i][k] * L[j][k];
+          max_error = MAX(max_error, fabs(cholmat(n, i, j) - sum));
+        }
+      }
+      printf("Maximum error in A - LL^T = %e\n", max_error);
+      matfreed(L);
+    }
+    vecfreed(buf);
+    vecfreei(displ);
+    vecfreei(cnt);
+  }
+
+  matfreed(a);
+  mpigrid_free(grid);
+  MPI_Finalize();
+
+  exit(0);
+
+} /* end main */
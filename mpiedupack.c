@@ -61,6 +61,48 @@ double **matallocd(int m, int n) {
 
 } /* end matallocd */
 
+float *vecallocf(int n) {
+  /* This function allocates a vector of floats of length n */
+  float *pf;
+
+  if (n == 0) {
+    pf = NULL;
+  } else {
+    pf = (float *)malloc(n * SZFLT);
+    if (pf == NULL)
+      MPI_Abort(MPI_COMM_WORLD, -2);
+  }
+  return pf;
+
+} /* end vecallocf */
+
+float **matallocf(int m, int n) {
+  /* This function allocates an m x n matrix of floats */
+  int i;
+  float *pf, **ppf;
+
+  if (m == 0) {
+    ppf = NULL;
+  } else {
+    ppf = (float **)malloc(m * sizeof(float *));
+    if (ppf == NULL)
+      MPI_Abort(MPI_COMM_WORLD, -4);
+    if (n == 0) {
+      for (i = 0; i < m; i++)
+        ppf[i] = NULL;
+    } else {
+      pf = (float *)malloc(m * n * SZFLT);
+      if (pf == NULL)
+        MPI_Abort(MPI_COMM_WORLD, -4);
+      ppf[0] = pf;
+      for (i = 1; i < m; i++)
+        ppf[i] = ppf[i - 1] + n;
+    }
+  }
+  return ppf;
+
+} /* end matallocf */
+
 void vecfreed(double *pd) {
   /* This function frees a vector of doubles */
 
@@ -87,3 +129,60 @@ void matfreed(double **ppd) {
   }
 
 } /* end matfreed */
+
+void vecfreef(float *pf) {
+  /* This function frees a vector of floats */
+
+  if (pf != NULL)
+    free(pf);
+
+} /* end vecfreef */
+
+void matfreef(float **ppf) {
+  /* This function frees a matrix of floats */
+
+  if (ppf != NULL) {
+    if (ppf[0] != NULL)
+      free(ppf[0]);
+    free(ppf);
+  }
+
+} /* end matfreef */
+
+void leastsquares(int h0, int h1, double *t, double *g, double *l) {
+  /* This function computes the parameters g and l of the
+     linear function T(h)= g*h+l that best fits
+     the data points (h,t[h]) with h0 <= h <= h1. */
+
+  double nh, sumt, sumth, sumh, sumhh, a;
+  int h;
+
+  nh = h1 - h0 + 1;
+  /* Compute sums:
+      sumt  =  sum of t[h] over h0 <= h <= h1
+      sumth =         t[h]*h
+      sumh  =         h
+      sumhh =         h*h     */
+  sumt = sumth = 0.0;
+  for (h = h0; h <= h1; h++) {
+    sumt += t[h];
+    sumth += t[h] * h;
+  }
+  sumh = (h1 * h1 - h0 * h0 + h1 + h0) / 2;
+  sumhh = (h1 * (h1 + 1) * (2 * h1 + 1) - (h0 - 1) * h0 * (2 * h0 - 1)) / 6;
+
+  /* Solve      nh*l +  sumh*g =  sumt
+              sumh*l + sumhh*g = sumth */
+  if (fabs(nh) > fabs(sumh)) {
+    a = sumh / nh;
+    /* subtract a times first eqn from second eqn */
+    *g = (sumth - a * sumt) / (sumhh - a * sumh);
+    *l = (sumt - sumh * *g) / nh;
+  } else {
+    a = nh / sumh;
+    /* subtract a times second eqn from first eqn */
+    *g = (sumt - a * sumth) / (sumh - a * sumhh);
+    *l = (sumth - sumhh * *g) / sumh;
+  }
+
+} /* end leastsquares */
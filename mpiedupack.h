@@ -16,6 +16,7 @@
 
 #define SZDBL (sizeof(double))
 #define SZINT (sizeof(int))
+#define SZFLT (sizeof(float))
 #define TRUE (1)
 #define FALSE (0)
 #define MAX(a, b) ((a) > (b) ? (a) : (b))
@@ -24,6 +25,11 @@
 double *vecallocd(int n);
 int *vecalloci(int n);
 double **matallocd(int m, int n);
+float *vecallocf(int n);
+float **matallocf(int m, int n);
 void vecfreed(double *pd);
 void vecfreei(int *pi);
 void matfreed(double **ppd);
+void vecfreef(float *pf);
+void matfreef(float **ppf);
+void leastsquares(int h0, int h1, double *t, double *g, double *l);
@@ -0,0 +1,227 @@
+#include "mpiedupack.h"
+#include "mpigrid.h"
+
+/* Default BSP parameters in flops for mpigrid_choose,
+   typical of a cluster with a fast network */
+#define BSP_G 20.0
+#define BSP_L 20000.0
+
+struct mpigrid *mpigrid_create(int M, int N, MPI_Comm comm) {
+  /* Create an M by N processor grid from the processors of comm.
+     The grid communicator is created by MPI_Cart_create with
+     reordering allowed, so that the MPI library can map neighbouring
+     processors of the grid onto neighbouring cores. The processor
+     numbering s+t*M of the grid may therefore differ from the ranks
+     in comm, and the coordinates (s,t) must be taken from the grid.
+     If M*N is smaller than the number of processors of comm,
+     the remaining processors stay idle and obtain NULL.
+     All processors of comm must call this function.
+  */
+
+  void mpilu_maxabs(void *invec, void *inoutvec, int *len,
+                    MPI_Datatype *datatype);
+  struct mpigrid *grid;
+  int p, dims[2], periods[2], remain[2], coords[2];
+
+  MPI_Comm_size(comm, &p);
+  if (M * N > p)
+    MPI_Abort(MPI_COMM_WORLD, -5);
+
+  grid = (struct mpigrid *)malloc(sizeof(struct mpigrid));
+  if (grid == NULL)
+    MPI_Abort(MPI_COMM_WORLD, -13);
+  grid->M = M;
+  grid->N = N;
+
+  /* Dimension 0 is the processor column t and dimension 1 the
+     processor row s, so that the rank in row-major order is s+t*M */
+  dims[0] = N;
+  dims[1] = M;
+  periods[0] = periods[1] = FALSE;
+  MPI_Cart_create(comm, 2, dims, periods, TRUE, &grid->comm);
+  if (grid->comm == MPI_COMM_NULL) {
+    /* I am not part of the grid */
+    free(grid);
+    return NULL;
+  }
+  MPI_Comm_rank(grid->comm, &p);
+  MPI_Cart_coords(grid->comm, p, 2, coords);
+  grid->t = coords[0];
+  grid->s = coords[1];
+
+  /* Create the communicators for my processor row and column */
+  remain[0] = TRUE;
+  remain[1] = FALSE;
+  MPI_Cart_sub(grid->comm, remain, &grid->row_comm);
+  remain[0] = FALSE;
+  remain[1] = TRUE;
+  MPI_Cart_sub(grid->comm, remain, &grid->col_comm);
+
+  /* Create the datatype and operation of the pivot reduction */
+  MPI_Type_contiguous(3, MPI_DOUBLE, &grid->triple);
+  MPI_Type_commit(&grid->triple);
+  MPI_Op_create(mpilu_maxabs, TRUE, &grid->maxabs);
+
+  grid->c = 1;
+  grid->l = 0;
+  grid->depth_comm = grid->zcol_comm = MPI_COMM_NULL;
+
+  grid->nlk = grid->nuk = 0;
+  grid->lk = grid->uk = NULL;
+
+  return grid;
+
+} /* end mpigrid_create */
+
+struct mpigrid *mpigrid_create3(int M, int N, int c, MPI_Comm comm) {
+  /* Create an M by N by c processor grid from the processors of comm,
+     consisting of c layers that are each an M by N grid, and return
+     the grid of my layer. Processor P(s,t) of layer l has rank
+     s+t*M+l*M*N in the three-dimensional grid, which is created by
+     MPI_Cart_create with reordering allowed, as in mpigrid_create.
+     If M*N*c is smaller than the number of processors of comm,
+     the remaining processors stay idle and obtain NULL.
+     All processors of comm must call this function.
+  */
+
+  void mpilu_maxabs(void *invec, void *inoutvec, int *len,
+                    MPI_Datatype *datatype);
+  struct mpigrid *grid;
+  int p, dims[3], periods[3], remain[3], coords[3];
+
+  MPI_Comm cube;
+
+  MPI_Comm_size(comm, &p);
+  if (M * N * c > p)
+    MPI_Abort(MPI_COMM_WORLD, -5);
+
+  grid = (struct mpigrid *)malloc(sizeof(struct mpigrid));
+  if (grid == NULL)
+    MPI_Abort(MPI_COMM_WORLD, -13);
+  grid->M = M;
+  grid->N = N;
+  grid->c = c;
+
+  /* Dimension 0 is the layer l, dimension 1 the processor column t,
+     and dimension 2 the processor row s */
+  dims[0] = c;
+  dims[1] = N;
+  dims[2] = M;
+  periods[0] = periods[1] = periods[2] = FALSE;
+  MPI_Cart_create(comm, 3, dims, periods, TRUE, &cube);
+  if (cube == MPI_COMM_NULL) {
+    free(grid);
+    return NULL;
+  }
+  MPI_Comm_rank(cube, &p);
+  MPI_Cart_coords(cube, p, 3, coords);
+  grid->l = coords[0];
+  grid->t = coords[1];
+  grid->s = coords[2];
+
+  /* Create the communicators of my layer, processor row and column,
+     and those across the layers */
+  remain[0] = FALSE;
+  remain[1] = remain[2] = TRUE;
+  MPI_Cart_sub(cube, remain, &grid->comm);
+  remain[1] = TRUE;
+  remain[2] = FALSE;
+  MPI_Cart_sub(cube, remain, &grid->row_comm);
+  remain[1] = FALSE;
+  remain[2] = TRUE;
+  MPI_Cart_sub(cube, remain, &grid->col_comm);
+  remain[0] = TRUE;
+  remain[1] = remain[2] = FALSE;
+  MPI_Cart_sub(cube, remain, &grid->depth_comm);
+  remain[2] = TRUE;
+  MPI_Cart_sub(cube, remain, &grid->zcol_comm);
+  MPI_Comm_free(&cube);
+
+  MPI_Type_contiguous(3, MPI_DOUBLE, &grid->triple);
+  MPI_Type_commit(&grid->triple);
+  MPI_Op_create(mpilu_maxabs, TRUE, &grid->maxabs);
+
+  grid->nlk = grid->nuk = 0;
+  grid->lk = grid->uk = NULL;
+
+  return grid;
+
+} /* end mpigrid_create3 */
+
+void mpigrid_choose(int p, int n, double g, double l, int *M, int *N) {
+  /* Choose the shape M by N of the processor grid for mpilu
+     on an n by n matrix, with M*N <= p, for a BSP computer
+     with communication cost g and synchronisation cost l in flops,
+     as measured by mpibench. If g or l is not positive, the values
+     BSP_G and BSP_L are used instead.
+     Shapes M by N with M*N <= p are tried, so that some processors
+     may be left idle, e.g. if p is prime. Since for a fixed M the cost
+     decreases with N, only the largest N = p/M is tried for M <= sqrt(p),
+     and similarly the largest M = p/N for N <= sqrt(p).
+     The shape with the lowest BSP cost given by mpilu_cost is chosen.
+  */
+
+  double mpilu_cost(int M, int N, int n, double g, double l);
+  int d, i, M1, N1;
+  double cost, mincost;
+
+  if (g <= 0.0)
+    g = BSP_G;
+  if (l <= 0.0)
+    l = BSP_L;
+
+  *M = *N = 1;
+  mincost = mpilu_cost(1, 1, n, g, l);
+  for (d = 1; d * d <= p; d++) {
+    for (i = 0; i < 2; i++) {
+      /* Try the shapes d by p/d and p/d by d */
+      M1 = (i == 0 ? d : p / d);
+      N1 = (i == 0 ? p / d : d);
+      cost = mpilu_cost(M1, N1, n, g, l);
+      if (cost < mincost) {
+        mincost = cost;
+        *M = M1;
+        *N = N1;
+      }
+    }
+  }
+
+} /* end mpigrid_choose */
+
+void mpigrid_reserve(struct mpigrid *grid, int nlk, int nuk) {
+  /* Make sure that the buffers lk and uk of the grid have
+     at least nlk and nuk doubles. The buffers only grow,
+     so that repeated factorisations of the same size
+     do not allocate memory. */
+
+  if (nlk > grid->nlk) {
+    vecfreed(grid->lk);
+    grid->lk = vecallocd(nlk);
+    grid->nlk = nlk;
+  }
+  if (nuk > grid->nuk) {
+    vecfreed(grid->uk);
+    grid->uk = vecallocd(nuk);
+    grid->nuk = nuk;
+  }
+
+} /* end mpigrid_reserve */
+
+void mpigrid_free(struct mpigrid *grid) {
+  /* Free the grid with its communicators and buffers.
+     All processors of the grid must call this function. */
+
+  vecfreed(grid->uk);
+  vecfreed(grid->lk);
+  MPI_Op_free(&grid->maxabs);
+  MPI_Type_free(&grid->triple);
+  if (grid->zcol_comm != MPI_COMM_NULL)
+    MPI_Comm_free(&grid->zcol_comm);
+  if (grid->depth_comm != MPI_COMM_NULL)
+    MPI_Comm_free(&grid->depth_comm);
+  MPI_Comm_free(&grid->col_comm);
+  MPI_Comm_free(&grid->row_comm);
+  MPI_Comm_free(&grid->comm);
+  free(grid);
+
+} /* end mpigrid_free */
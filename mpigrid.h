@@ -0,0 +1,43 @@
+/* Two-dimensional M by N processor grid with the communicators and
+   buffers used by mpilu and the functions that share its distribution.
+   A grid is built once by mpigrid_create and can then be used for any
+   number of factorisations and solves, until it is freed by mpigrid_free.
+   A grid built by mpigrid_create3 is one of c layers of an M by N by c
+   processor grid, as used by mpilu25; the communicators comm, row_comm
+   and col_comm then refer to my own layer.
+*/
+
+/* Broadcast algorithms of mpilu_bcast, used by mpilu and mpimm */
+#define BCAST_MPI 0   /* MPI_Bcast of the MPI library */
+#define BCAST_RING 1  /* increasing ring */
+#define BCAST_RINGM 2 /* modified increasing ring */
+#define BCAST_2RING 3 /* two rings */
+#define BCASTSEG 4096 /* maximum number of doubles in a broadcast segment */
+
+struct mpigrid {
+  int M, N;             /* number of processor rows and columns */
+  int s, t;             /* my processor P(s,t), 0 <= s < M, 0 <= t < N */
+  MPI_Comm comm;        /* all processors, P(s,t) has rank s+t*M */
+  MPI_Comm row_comm;    /* my processor row P(s,*), P(s,t) has rank t */
+  MPI_Comm col_comm;    /* my processor column P(*,t), P(s,t) has rank s */
+  int c, l;             /* number of layers and my layer, 0 <= l < c */
+  MPI_Comm depth_comm;  /* P(s,t) in all layers, layer l has rank l */
+  MPI_Comm zcol_comm;   /* P(*,t) in all layers, with rank s+l*M */
+  MPI_Datatype triple;  /* datatype of the pivot reduction */
+  MPI_Op maxabs;        /* operation of the pivot reduction */
+  int nlk, nuk;         /* lengths of the buffers lk and uk */
+  double *lk, *uk;      /* buffers for a column and a row of a stage */
+};
+
+/* Plan of mpiredist for moving a matrix from the distribution of one
+   grid to that of another grid, built once by mpiredist_create.
+   All counts, displacements and indices are in doubles; the indices
+   point into the contiguous local parts a[0] of matallocd matrices. */
+struct mpiredist {
+  MPI_Comm comm;        /* processors taking part, containing both grids */
+  int *scount, *sdispl; /* doubles sent to every processor of comm */
+  int *rcount, *rdispl; /* doubles received from every processor */
+  int nsend, nrecv;     /* total numbers of doubles sent and received */
+  int *sidx, *ridx;     /* local indices in the order of the buffers */
+  double *sbuf, *rbuf;  /* send and receive buffers */
+};
@@ -0,0 +1,418 @@
+#include "mpiedupack.h"
+#include "mpigrid.h"
+
+int zrow(int b, int c, int l, int iz) {
+  /* Return the local row index in its layer of the local row iz
+     of layer l in the distribution over the combined processor
+     columns of c layers, see mpilu25. */
+
+  return ((iz / b) * c + l) * b + iz % b;
+
+} /* end zrow */
+
+void mpilu25_home(int M, int N, int s, int t, int c, int n, int b, int nb,
+                  int i, int *jU, int *hl, int *hu) {
+  /* Determine the homes of the elements of L\U in local row i of P(s,t)
+     after mpilu25: the local columns j < *jU are stored in layer *hl,
+     the layer of the row in the combined grid, and the columns
+     j >= *jU, which belong to U12 of the panel of the row,
+     in layer *hu. */
+
+  int nloc(int p, int s, int n, int b);
+  int gindex(int p, int s, int i, int b);
+  int gi, k0, ke;
+
+  gi = gindex(M, s, i, b);
+  k0 = (gi / b) * b;
+  k0 += ((gi - k0) / nb) * nb; /* first column of the panel of row gi */
+  ke = MIN(MIN(k0 + nb, (gi / b + 1) * b), n);
+  *jU = nloc(N, t, ke, b);
+  *hl = (i / b) % c;
+  *hu = (gi - k0) % c;
+
+} /* end mpilu25_home */
+
+void mpilu25(struct mpigrid *grid, int n, int b, int nb, int *pi,
+             double **a) {
+  /* Compute LU decomposition of n by n matrix A with partial pivoting,
+     using panels of at most nb columns, on an M by N by c processor
+     grid created by mpigrid_create3, which consists of c layers that
+     are each an M by N grid.
+     Program text for P(s,t) of layer l.
+     On input, A is given on layer 0, distributed according to the
+     M by N block-cyclic distribution with b by b blocks, as in mpilu,
+     and on output, layer 0 holds L\U and pi, as mpilu_blocked does,
+     with the same pivots in exact arithmetic. On the other layers,
+     a is used as workspace and pi is not referenced.
+
+     A panel never crosses a distribution block, so that it has
+     min(nb,b) columns or fewer, and its columns belong to one
+     processor column tk and its diagonal block to one processor
+     row sk. Every layer keeps its own copy of the trailing matrix,
+     and the trailing matrix being factored is the sum of the copies.
+     The layers share the work of every trailing update
+     A22 -= L21*U12: layer l computes the part of the product with
+     the columns kk of L21 and rows kk of U12 with kk mod c = l.
+     The elements of L\U are computed in one layer only, their home.
+     For the L part and the panel, this is the layer that holds the
+     row in the M*c by N block-cyclic distribution of the combined
+     processor columns, with row z = s+l*M of P(s,t) in layer l.
+
+     For each panel, the steps are:
+         reduction of the panel over the layers in processor column
+             tk, where layer l receives the local rows i with
+             (i div b) mod c = l, so that the processor columns
+             P(*,tk) of all layers together hold the panel in the
+             combined distribution,
+         factorisation of the panel on the combined processor column
+             by mpilu_factorpanel, and broadcast of the pivots,
+             and of L11\U11 to processor row sk,
+         row swaps of the L part on the combined processor columns,
+             and of the trailing columns in every layer,
+         triangular solve of every layer's own copy of A12 by L11 in
+             processor row sk, followed by one reduction over the
+             layers that gives layer l the rows kk mod c = l of U12,
+             which are then broadcast within its processor column,
+         exchange of the columns kk of L21 over the layers in
+             processor column tk, so that layer l holds the columns
+             kk mod c = l, which are then broadcast within its
+             processor row,
+         update of my copy of A by my slice of the product.
+     Afterwards, the elements are gathered from their homes
+     into layer 0.
+
+     Compared with mpilu_blocked on the same p = M*N*c processors,
+     where every processor receives about n^2/(2M') words of L21
+     and n^2/(2N') of U12 on an M' by N' grid, every processor
+     here receives about n^2/(2Mc) words of L21 and n^2/(2Nc) of U12,
+     which is a factor sqrt(c) less for square grids. The price is
+     the reduction of every element once and the final gather,
+     about 2(c-1)n^2/p words, and the row swaps of the trailing
+     columns in all layers, so that the saving only shows for c = 2
+     and p = M*N*c of at least about 32. mpilu25_test measures both.
+  */
+
+  int nloc(int p, int s, int n, int b);
+  int owner(int p, int k, int b);
+  int gindex(int p, int s, int i, int b);
+  int zrow(int b, int c, int l, int iz);
+  void mpilu25_home(int M, int N, int s, int t, int c, int n, int b, int nb,
+                    int i, int *jU, int *hl, int *hu);
+  void mm_sub(int m, int n, int kb, double **l, double **u, double **c,
+              int jc);
+  void mpilu_laswp(int M, int s, int b, int nlc, int kc0, int kce, int k0,
+                   int kb, int *piv, int *pi, double **a, MPI_Comm col_comm_t);
+  void mpilu_factorpanel(int M, int s, int b, int n, int nlr, int k0, int kb,
+                         double **P, double **LU11, int *piv, double *prow,
+                         MPI_Comm col_comm_t);
+  double **Az, **Pz, **LU11, **Lp, **Up, *lbuf, *ubuf, *prow, *buf, *buf1;
+  int M, N, s, t, c, l, z, nlr, nlc, nlrz, k0, kb, ke, sk, tk, kr0, kre, kc0,
+      kce, kr0z, krez, nr, ncols, nsl, len, lz, zz, kk, jj, m, i, iz, j, pos,
+      jU, hl, hu, *piv, *piz, *cnt, *displ, *rcnt, *rdispl;
+
+  MPI_Comm row_comm_s, col_comm_t, depth_comm, zcol_comm;
+
+  M = grid->M;
+  N = grid->N;
+  s = grid->s;
+  t = grid->t;
+  c = grid->c;
+  l = grid->l;
+  row_comm_s = grid->row_comm;
+  col_comm_t = grid->col_comm;
+  depth_comm = grid->depth_comm;
+  zcol_comm = (c > 1 ? grid->zcol_comm : col_comm_t);
+  z = s + l * M; /* my processor row in the combined grid */
+
+  nlr = nloc(M, s, n, b);         /* number of local rows */
+  nlc = nloc(N, t, n, b);         /* number of local columns */
+  nlrz = nloc(M * c, z, n, b);    /* number of local rows of my part */
+
+  LU11 = matallocd(nb, nb);
+  lbuf = vecallocd(nlr * nb);
+  ubuf = vecallocd(nb * nlc);
+  prow = vecallocd(nb);
+  buf = vecallocd(MAX(nlr * nb, nb * nlc) + nb * nb);
+  buf1 = vecallocd(MAX(nlr * nb, nb * nlc));
+  piv = vecalloci(nb);
+  piz = vecalloci(nlrz);
+  cnt = vecalloci(c);
+  displ = vecalloci(c);
+  rcnt = vecalloci(c);
+  rdispl = vecalloci(c);
+
+  /* Az[iz] is the row of my copy of A that holds my row iz
+     of the combined grid, Pz[iz] its part in the panel.
+     Lp and Up point to the rows of my slices of L21 and U12. */
+  Az = (double **)malloc(MAX(nlrz, 1) * sizeof(double *));
+  Pz = (double **)malloc(MAX(nlrz, 1) * sizeof(double *));
+  Lp = (double **)malloc(MAX(nlr, 1) * sizeof(double *));
+  Up = (double **)malloc(nb * sizeof(double *));
+  if (Az == NULL || Pz == NULL || Lp == NULL || Up == NULL)
+    MPI_Abort(MPI_COMM_WORLD, -13);
+  for (iz = 0; iz < nlrz; iz++)
+    Az[iz] = a[zrow(b, c, l, iz)];
+
+  /* Initialize the permutation of my rows of the combined grid
+     and the other layers */
+  if (t == 0) {
+    for (iz = 0; iz < nlrz; iz++)
+      piz[iz] = gindex(M * c, z, iz, b); /* global row index */
+  }
+  if (l > 0) {
+    for (i = 0; i < nlr; i++) {
+      for (j = 0; j < nlc; j++)
+        a[i][j] = 0.0;
+    }
+  }
+
+  for (k0 = 0; k0 < n; k0 += kb) {
+    kb = MIN(MIN(nb, b - k0 % b), n - k0); /* columns of the panel */
+    ke = k0 + kb;
+    sk = owner(M, k0, b);
+    tk = owner(N, k0, b);
+    kr0 = nloc(M, s, k0, b);
+    kre = nloc(M, s, ke, b);
+    kc0 = nloc(N, t, k0, b);
+    kce = nloc(N, t, ke, b);
+    kr0z = nloc(M * c, z, k0, b);
+    krez = nloc(M * c, z, ke, b);
+    nr = nlr - kre;  /* number of my rows of L21 */
+    ncols = nlc - kce; /* number of my columns of U12 */
+    nsl = (l < kb ? (kb - l + c - 1) / c : 0); /* number of kk = l mod c */
+
+    if (t == tk) {
+      /****** Superstep 0. Reduce the panel over the layers ******/
+      if (c > 1) {
+        pos = 0;
+        for (lz = 0; lz < c; lz++) {
+          zz = s + lz * M;
+          for (iz = nloc(M * c, zz, k0, b); iz < nloc(M * c, zz, n, b);
+               iz++) {
+            i = zrow(b, c, lz, iz);
+            for (j = kc0; j < kce; j++)
+              buf[pos++] = a[i][j];
+          }
+          cnt[lz] = (nloc(M * c, zz, n, b) - nloc(M * c, zz, k0, b)) * kb;
+        }
+        MPI_Reduce_scatter(buf, buf1, cnt, MPI_DOUBLE, MPI_SUM, depth_comm);
+        for (i = kr0; i < nlr; i++) {
+          for (j = kc0; j < kce; j++)
+            a[i][j] = 0.0;
+        }
+        pos = 0;
+        for (iz = kr0z; iz < nlrz; iz++) {
+          for (j = kc0; j < kce; j++)
+            Az[iz][j] = buf1[pos++];
+        }
+      }
+
+      /****** Superstep 1. Factor the panel on the combined grid ******/
+      for (iz = 0; iz < nlrz; iz++)
+        Pz[iz] = Az[iz] + kc0;
+      mpilu_factorpanel(M * c, z, b, n, nlrz, k0, kb, Pz, LU11, piv, prow,
+                        zcol_comm);
+
+      /* Pack the pivots, and L11\U11 for processor row sk */
+      for (kk = 0; kk < kb; kk++)
+        buf[kk] = (double)piv[kk];
+      if (s == sk) {
+        for (kk = 0; kk < kb; kk++) {
+          for (jj = 0; jj < kb; jj++)
+            buf[kb + kk * kb + jj] = LU11[kk][jj];
+        }
+      }
+    }
+    len = kb + (s == sk ? kb * kb : 0);
+    MPI_Bcast(buf, len, MPI_DOUBLE, tk, row_comm_s);
+    if (t != tk) {
+      for (kk = 0; kk < kb; kk++)
+        piv[kk] = (int)buf[kk];
+      if (s == sk) {
+        for (kk = 0; kk < kb; kk++) {
+          for (jj = 0; jj < kb; jj++)
+            LU11[kk][jj] = buf[kb + kk * kb + jj];
+        }
+      }
+    }
+
+    /****** Superstep 2. Swap rows outside the panel ******/
+    /* The L part is stored in one layer, in the combined grid */
+    if (kc0 > 0 || t == 0)
+      mpilu_laswp(M * c, z, b, kc0, kc0, kc0, k0, kb, piv,
+                  (t == 0 ? piz : NULL), Az, zcol_comm);
+    /* The trailing columns are a sum over the layers */
+    if (ncols > 0)
+      mpilu_laswp(M, s, b, nlc, 0, kce, k0, kb, piv, NULL, a, col_comm_t);
+
+    /****** Superstep 3. Compute U12 = inv(L11)*A12 ******/
+    if (s == sk && ncols > 0) {
+      /* Solve with my copy of A12, which is a term of the sum */
+      for (kk = 0; kk < kb; kk++) {
+        for (j = 0; j < ncols; j++)
+          buf[kk * ncols + j] = a[kr0 + kk][kce + j];
+      }
+      for (kk = 1; kk < kb; kk++) {
+        for (jj = 0; jj < kk; jj++) {
+          for (j = 0; j < ncols; j++)
+            buf[kk * ncols + j] -= LU11[kk][jj] * buf[jj * ncols + j];
+        }
+      }
+
+      /* Add the terms, where layer lz obtains the rows kk = lz mod c */
+      if (c > 1) {
+        pos = 0;
+        for (lz = 0; lz < c; lz++) {
+          for (kk = lz; kk < kb; kk += c) {
+            for (j = 0; j < ncols; j++)
+              buf1[pos++] = buf[kk * ncols + j];
+          }
+          cnt[lz] = (lz < kb ? (kb - lz + c - 1) / c : 0) * ncols;
+        }
+        MPI_Reduce_scatter(buf1, ubuf, cnt, MPI_DOUBLE, MPI_SUM, depth_comm);
+      } else {
+        for (j = 0; j < kb * ncols; j++)
+          ubuf[j] = buf[j];
+      }
+
+      /* Store my rows of U12, whose home is my layer */
+      for (kk = 0; kk < kb; kk++) {
+        for (j = kce; j < nlc; j++)
+          a[kr0 + kk][j] = 0.0;
+      }
+      for (m = 0; m < nsl; m++) {
+        for (j = 0; j < ncols; j++)
+          a[kr0 + l + m * c][kce + j] = ubuf[m * ncols + j];
+      }
+    }
+    if (nsl * ncols > 0)
+      MPI_Bcast(ubuf, nsl * ncols, MPI_DOUBLE, sk, col_comm_t);
+
+    /****** Superstep 4. Distribute my slice of L21 ******/
+    if (t == tk) {
+      if (c > 1) {
+        /* Send my rows of L21 in columns kk = lz mod c to layer lz */
+        pos = 0;
+        for (lz = 0; lz < c; lz++) {
+          displ[lz] = pos;
+          for (iz = krez; iz < nlrz; iz++) {
+            for (kk = lz; kk < kb; kk += c)
+              buf[pos++] = Pz[iz][kk];
+          }
+          cnt[lz] = pos - displ[lz];
+          zz = s + lz * M;
+          rcnt[lz] = (nloc(M * c, zz, n, b) - nloc(M * c, zz, ke, b)) * nsl;
+        }
+        rdispl[0] = 0;
+        for (lz = 1; lz < c; lz++)
+          rdispl[lz] = rdispl[lz - 1] + rcnt[lz - 1];
+        MPI_Alltoallv(buf, cnt, displ, MPI_DOUBLE, buf1, rcnt, rdispl,
+                      MPI_DOUBLE, depth_comm);
+        for (lz = 0; lz < c; lz++) {
+          pos = rdispl[lz];
+          zz = s + lz * M;
+          for (iz = nloc(M * c, zz, ke, b); iz < nloc(M * c, zz, n, b);
+               iz++) {
+            i = zrow(b, c, lz, iz);
+            for (m = 0; m < nsl; m++)
+              lbuf[(i - kre) * nsl + m] = buf1[pos++];
+          }
+        }
+      } else {
+        for (i = kre; i < nlr; i++) {
+          for (m = 0; m < kb; m++)
+            lbuf[(i - kre) * kb + m] = a[i][kc0 + m];
+        }
+      }
+    }
+    if (nr * nsl > 0)
+      MPI_Bcast(lbuf, nr * nsl, MPI_DOUBLE, tk, row_comm_s);
+
+    /****** Superstep 0. Update of my copy of A ******/
+    if (nr > 0 && ncols > 0 && nsl > 0) {
+      for (i = 0; i < nr; i++)
+        Lp[i] = lbuf + i * nsl;
+      for (m = 0; m < nsl; m++)
+        Up[m] = ubuf + m * ncols;
+      mm_sub(nr, ncols, nsl, Lp, Up, &a[kre], kce);
+    }
+  }
+
+  /****** Gather the elements of L\U from their homes into layer 0 ******/
+  for (lz = 0; lz < c; lz++)
+    cnt[lz] = 0;
+  for (i = 0; i < nlr; i++) {
+    mpilu25_home(M, N, s, t, c, n, b, nb, i, &jU, &hl, &hu);
+    cnt[hl] += jU + (t == 0 ? 1 : 0);
+    cnt[hu] += nlc - jU;
+  }
+  if (c > 1) {
+    len = (l == 0 ? 0 : cnt[l]);
+    cnt[0] = 0;
+    rdispl[0] = 0;
+    for (lz = 1; lz < c; lz++)
+      rdispl[lz] = rdispl[lz - 1] + cnt[lz - 1];
+    vecfreed(buf1);
+    vecfreed(buf);
+    buf = vecallocd(len);
+    buf1 = vecallocd(l == 0 ? rdispl[c - 1] + cnt[c - 1] : 0);
+  }
+  pos = 0;
+  for (i = 0; i < nlr; i++) {
+    mpilu25_home(M, N, s, t, c, n, b, nb, i, &jU, &hl, &hu);
+    iz = ((i / b) / c) * b + i % b; /* my row of the combined grid */
+    if (l == 0 && hl == 0 && t == 0)
+      pi[i] = piz[iz];
+    if (c > 1 && l > 0) {
+      /* Pack my elements of row i */
+      if (hl == l) {
+        for (j = 0; j < jU; j++)
+          buf[pos++] = a[i][j];
+        if (t == 0)
+          buf[pos++] = (double)piz[iz];
+      }
+      if (hu == l) {
+        for (j = jU; j < nlc; j++)
+          buf[pos++] = a[i][j];
+      }
+    }
+  }
+  if (c > 1) {
+    MPI_Gatherv(buf, len, MPI_DOUBLE, buf1, cnt, rdispl, MPI_DOUBLE, 0,
+                depth_comm);
+    if (l == 0) {
+      /* Unpack the elements of the other layers, in the same order */
+      for (i = 0; i < nlr; i++) {
+        mpilu25_home(M, N, s, t, c, n, b, nb, i, &jU, &hl, &hu);
+        if (hl > 0) {
+          for (j = 0; j < jU; j++)
+            a[i][j] = buf1[rdispl[hl]++];
+          if (t == 0)
+            pi[i] = (int)buf1[rdispl[hl]++];
+        }
+        if (hu > 0) {
+          for (j = jU; j < nlc; j++)
+            a[i][j] = buf1[rdispl[hu]++];
+        }
+      }
+    }
+  }
+
+  free(Up);
+  free(Lp);
+  free(Pz);
+  free(Az);
+  vecfreei(rdispl);
+  vecfreei(rcnt);
+  vecfreei(displ);
+  vecfreei(cnt);
+  vecfreei(piz);
+  vecfreei(piv);
+  vecfreed(buf1);
+  vecfreed(buf);
+  vecfreed(prow);
+  vecfreed(ubuf);
+  vecfreed(lbuf);
+  matfreed(LU11);
+
+} /* end mpilu25 */
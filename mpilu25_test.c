@@ -0,0 +1,339 @@
+#include "mpiedupack.h"
+#include "mpigrid.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/*  This is a test program which compares the 2.5D LU decomposition
+    mpilu25 on an M by N by c processor grid with the 2D blocked
+    LU decomposition mpilu_blocked, with batched row interchanges,
+    on an M2 by N2 grid of the same p = M*N*c processors, where M2
+    is the largest divisor of p with M2 <= sqrt(p).
+
+    The input matrix A is a pseudo-random matrix with elements
+    in [-1,1], computed from the global indices, so that every
+    processor can generate its own part. Both decompositions use
+    panels of nb columns and partial pivoting, and hence the same
+    pivots. After each decomposition, the system AX = B is solved
+    by mpilu_solve, where B = AX for the exact solution X given by
+    X(i)= 1 + i mod 3.
+
+    For each decomposition, the time, the maximum and average number
+    of words (doubles) received by a processor during the
+    decomposition, and the maximum error in X are printed, followed
+    by the bandwidth reduction, i.e. the ratio of the maximum number
+    of words of the 2D and the 2.5D decomposition.
+
+    The words are counted through the MPI profiling interface:
+    the MPI functions used by the decompositions are redefined below
+    and call their PMPI versions. A collective operation is counted
+    as if it were performed by direct sends, e.g. a broadcast
+    of v words as v words received by every processor except the root,
+    and a reduction of v words over q processors as (q-1)v words
+    received by the processor that obtains the result.
+    The 2.5D decomposition only receives fewer words for large
+    enough grids, e.g. M = 4, N = 8, c = 2 with p = 64.
+*/
+
+static int counting = FALSE; /* TRUE if the words are counted */
+static double nwords = 0.0;  /* number of words received */
+
+void count(int n, MPI_Datatype datatype) {
+  /* Count the receipt of n elements of type datatype */
+  int size;
+
+  if (counting) {
+    MPI_Type_size(datatype, &size);
+    nwords += (double)n * size / SZDBL;
+  }
+
+} /* end count */
+
+int MPI_Recv(void *buf, int cnt, MPI_Datatype datatype, int source, int tag,
+             MPI_Comm comm, MPI_Status *status) {
+  count(cnt, datatype);
+  return PMPI_Recv(buf, cnt, datatype, source, tag, comm, status);
+}
+
+int MPI_Sendrecv(const void *sendbuf, int sendcount, MPI_Datatype sendtype,
+                 int dest, int sendtag, void *recvbuf, int recvcount,
+                 MPI_Datatype recvtype, int source, int recvtag,
+                 MPI_Comm comm, MPI_Status *status) {
+  count(recvcount, recvtype);
+  return PMPI_Sendrecv(sendbuf, sendcount, sendtype, dest, sendtag, recvbuf,
+                       recvcount, recvtype, source, recvtag, comm, status);
+}
+
+int MPI_Sendrecv_replace(void *buf, int cnt, MPI_Datatype datatype,
+                         int dest, int sendtag, int source, int recvtag,
+                         MPI_Comm comm, MPI_Status *status) {
+  count(cnt, datatype);
+  return PMPI_Sendrecv_replace(buf, cnt, datatype, dest, sendtag, source,
+                               recvtag, comm, status);
+}
+
+int MPI_Bcast(void *buf, int cnt, MPI_Datatype datatype, int root,
+              MPI_Comm comm) {
+  int rank;
+
+  MPI_Comm_rank(comm, &rank);
+  if (rank != root)
+    count(cnt, datatype);
+  return PMPI_Bcast(buf, cnt, datatype, root, comm);
+}
+
+int MPI_Allreduce(const void *sendbuf, void *recvbuf, int cnt,
+                  MPI_Datatype datatype, MPI_Op op, MPI_Comm comm) {
+  int q;
+
+  MPI_Comm_size(comm, &q);
+  count((q - 1) * cnt, datatype);
+  return PMPI_Allreduce(sendbuf, recvbuf, cnt, datatype, op, comm);
+}
+
+int MPI_Reduce(const void *sendbuf, void *recvbuf, int cnt,
+               MPI_Datatype datatype, MPI_Op op, int root, MPI_Comm comm) {
+  int q, rank;
+
+  MPI_Comm_size(comm, &q);
+  MPI_Comm_rank(comm, &rank);
+  if (rank == root)
+    count((q - 1) * cnt, datatype);
+  return PMPI_Reduce(sendbuf, recvbuf, cnt, datatype, op, root, comm);
+}
+
+int MPI_Reduce_scatter(const void *sendbuf, void *recvbuf,
+                       const int recvcounts[], MPI_Datatype datatype,
+                       MPI_Op op, MPI_Comm comm) {
+  int q, rank;
+
+  MPI_Comm_size(comm, &q);
+  MPI_Comm_rank(comm, &rank);
+  count((q - 1) * recvcounts[rank], datatype);
+  return PMPI_Reduce_scatter(sendbuf, recvbuf, recvcounts, datatype, op,
+                             comm);
+}
+
+int MPI_Allgatherv(const void *sendbuf, int sendcount, MPI_Datatype sendtype,
+                   void *recvbuf, const int recvcounts[], const int displs[],
+                   MPI_Datatype recvtype, MPI_Comm comm) {
+  int q, rank, r;
+
+  MPI_Comm_size(comm, &q);
+  MPI_Comm_rank(comm, &rank);
+  for (r = 0; r < q; r++) {
+    if (r != rank)
+      count(recvcounts[r], recvtype);
+  }
+  return PMPI_Allgatherv(sendbuf, sendcount, sendtype, recvbuf, recvcounts,
+                         displs, recvtype, comm);
+}
+
+int MPI_Gatherv(const void *sendbuf, int sendcount, MPI_Datatype sendtype,
+                void *recvbuf, const int recvcounts[], const int displs[],
+                MPI_Datatype recvtype, int root, MPI_Comm comm) {
+  int q, rank, r;
+
+  MPI_Comm_size(comm, &q);
+  MPI_Comm_rank(comm, &rank);
+  if (rank == root) {
+    for (r = 0; r < q; r++) {
+      if (r != rank)
+        count(recvcounts[r], recvtype);
+    }
+  }
+  return PMPI_Gatherv(sendbuf, sendcount, sendtype, recvbuf, recvcounts,
+                      displs, recvtype, root, comm);
+}
+
+int MPI_Alltoallv(const void *sendbuf, const int sendcounts[],
+                  const int sdispls[], MPI_Datatype sendtype, void *recvbuf,
+                  const int recvcounts[], const int rdispls[],
+                  MPI_Datatype recvtype, MPI_Comm comm) {
+  int q, rank, r;
+
+  MPI_Comm_size(comm, &q);
+  MPI_Comm_rank(comm, &rank);
+  for (r = 0; r < q; r++) {
+    if (r != rank)
+      count(recvcounts[r], recvtype);
+  }
+  return PMPI_Alltoallv(sendbuf, sendcounts, sdispls, sendtype, recvbuf,
+                        recvcounts, rdispls, recvtype, comm);
+}
+
+double testmat(int i, int j) {
+  /* Return the element A(i,j) of the test matrix */
+  unsigned int x;
+
+  x = (unsigned int)i * 2654435761u ^ ((unsigned int)j * 40503u + 7u);
+  x ^= x >> 13;
+  x *= 0x5bd1e995u;
+  x ^= x >> 15;
+  return (x % 10000) / 5000.0 - 1.0;
+
+} /* end testmat */
+
+void runlu(struct mpigrid *grid, int n, int b, int nb, double *time,
+           double *words, double *error) {
+  /* Generate the test matrix A and right-hand side B on the grid,
+     factor A by mpilu25 if the grid has more than one layer and by
+     mpilu_blocked otherwise, and solve AX = B on layer 0.
+     On output, time is the time of the decomposition, words the
+     number of words received by me during the decomposition,
+     and error the maximum error in X over layer 0.
+     All processors of the grid must call this function. */
+
+  int nloc(int p, int s, int n, int b);
+  int gindex(int p, int s, int i, int b);
+  double testmat(int i, int j);
+  void mpilu_blocked(struct mpigrid *grid, int n, int b, int nb, int batch,
+                     int calu, int *pi, double **a);
+  void mpilu25(struct mpigrid *grid, int n, int b, int nb, int *pi,
+               double **a);
+  void mpilu_solve(struct mpigrid *grid, int n, int b, int nrhs, int *pi,
+                   double **a, double **x);
+  int M, N, s, t, nlr, nlc, i, j, iglob, *pi;
+  double **a, **x, time0, max_error;
+
+  M = grid->M;
+  N = grid->N;
+  s = grid->s;
+  t = grid->t;
+  nlr = nloc(M, s, n, b);
+  nlc = nloc(N, t, n, b);
+  a = matallocd(nlr, nlc);
+  x = matallocd(nlr, 1);
+  pi = vecalloci(nlr);
+
+  for (i = 0; i < nlr; i++) {
+    iglob = gindex(M, s, i, b);
+    for (j = 0; j < nlc; j++)
+      a[i][j] = testmat(iglob, gindex(N, t, j, b));
+  }
+
+  /* Compute my rows of B = AX, for all columns of A */
+  for (i = 0; i < nlr; i++) {
+    iglob = gindex(M, s, i, b);
+    x[i][0] = 0.0;
+    for (j = 0; j < n; j++)
+      x[i][0] += testmat(iglob, j) * (1 + j % 3);
+  }
+
+  MPI_Barrier(MPI_COMM_WORLD);
+  time0 = MPI_Wtime();
+  nwords = 0.0;
+  counting = TRUE;
+  if (grid->c > 1)
+    mpilu25(grid, n, b, nb, pi, a);
+  else
+    mpilu_blocked(grid, n, b, nb, TRUE, FALSE, pi, a);
+  counting = FALSE;
+  *words = nwords;
+  MPI_Barrier(MPI_COMM_WORLD);
+  *time = MPI_Wtime() - time0;
+
+  max_error = 0.0;
+  if (grid->l == 0) {
+    mpilu_solve(grid, n, b, 1, pi, a, x);
+    for (i = 0; i < nlr; i++) {
+      iglob = gindex(M, s, i, b);
+      max_error = MAX(max_error, fabs(x[i][0] - (1 + iglob % 3)));
+    }
+  }
+  MPI_Allreduce(&max_error, error, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+
+  vecfreei(pi);
+  matfreed(x);
+  matfreed(a);
+
+} /* end runlu */
+
+int main(int argc, char **argv) {
+
+  struct mpigrid *mpigrid_create(int M, int N, MPI_Comm comm);
+  struct mpigrid *mpigrid_create3(int M, int N, int c, MPI_Comm comm);
+  void mpigrid_free(struct mpigrid *grid);
+  void runlu(struct mpigrid *grid, int n, int b, int nb, double *time,
+             double *words, double *error);
+  int p, pid, provided, M, N, c, M2, N2, n, b, nb, alg, q;
+  double time[2], words, maxwords[2], sumwords[2], error[2];
+  struct mpigrid *grid;
+
+  /* Only the master thread of each processor communicates */
+  MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+#ifdef _OPENMP
+  if (provided < MPI_THREAD_FUNNELED)
+    omp_set_num_threads(1);
+#endif
+
+  MPI_Comm_size(MPI_COMM_WORLD, &p);
+  MPI_Comm_rank(MPI_COMM_WORLD, &pid);
+
+  if (pid == 0) {
+    printf("Please enter number of processor rows M:\n");
+    scanf("%d", &M);
+    printf("Please enter number of processor columns N:\n");
+    scanf("%d", &N);
+    printf("Please enter number of layers c:\n");
+    scanf("%d", &c);
+    if (c < 1 || M * N * c != p)
+      MPI_Abort(MPI_COMM_WORLD, -5);
+    printf("Please enter matrix size n:\n");
+    scanf("%d", &n);
+    printf("Please enter distribution block size b:\n");
+    scanf("%d", &b);
+    if (b < 1)
+      MPI_Abort(MPI_COMM_WORLD, -12);
+    printf("Please enter panel width nb:\n");
+    scanf("%d", &nb);
+    if (nb < 1)
+      MPI_Abort(MPI_COMM_WORLD, -12);
+  }
+  MPI_Bcast(&M, 1, MPI_INT, 0, MPI_COMM_WORLD);
+  MPI_Bcast(&N, 1, MPI_INT, 0, MPI_COMM_WORLD);
+  MPI_Bcast(&c, 1, MPI_INT, 0, MPI_COMM_WORLD);
+  MPI_Bcast(&n, 1, MPI_INT, 0, MPI_COMM_WORLD);
+  MPI_Bcast(&b, 1, MPI_INT, 0, MPI_COMM_WORLD);
+  MPI_Bcast(&nb, 1, MPI_INT, 0, MPI_COMM_WORLD);
+
+  /* Choose the 2D grid of the same processors */
+  for (M2 = 1, q = 1; q * q <= p; q++) {
+    if (p % q == 0)
+      M2 = q;
+  }
+  N2 = p / M2;
+
+  if (pid == 0) {
+    printf("LU decomposition of %d by %d matrix\n", n, n);
+    printf("with %d by %d blocks and panels of %d columns\n", b, b, nb);
+    printf("2D:   %d by %d grid\n", M2, N2);
+    printf("2.5D: %d by %d by %d grid\n", M, N, c);
+  }
+
+  for (alg = 0; alg < 2; alg++) {
+    if (alg == 0)
+      grid = mpigrid_create(M2, N2, MPI_COMM_WORLD);
+    else
+      grid = mpigrid_create3(M, N, c, MPI_COMM_WORLD);
+    runlu(grid, n, b, nb, &time[alg], &words, &error[alg]);
+    MPI_Reduce(&words, &maxwords[alg], 1, MPI_DOUBLE, MPI_MAX, 0,
+               MPI_COMM_WORLD);
+    MPI_Reduce(&words, &sumwords[alg], 1, MPI_DOUBLE, MPI_SUM, 0,
+               MPI_COMM_WORLD);
+    mpigrid_free(grid);
+  }
+
+  if (pid == 0) {
+    printf("         time (s)   max words   avg words   error in X\n");
+    for (alg = 0; alg < 2; alg++)
+      printf("%-6s %10.6lf %11.0lf %11.0lf   %e\n", (alg == 0 ? "2D" : "2.5D"),
+             time[alg], maxwords[alg], sumwords[alg] / p, error[alg]);
+    printf("Bandwidth reduction = %.3lf\n", maxwords[0] / maxwords[1]);
+  }
+
+  MPI_Finalize();
+
+  exit(0);
+
+} /* end main */
@@ -1,4 +1,9 @@
 #include "mpiedupack.h"
+#include "mpigrid.h"
+#include <string.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 /*  This is a test program which uses mpilu to decompose an n by n
     matrix A into triangular factors L and U, with partial row pivoting.
@@ -28,97 +33,535 @@
     In stage k of the LU decomposition, row k is swapped with row r=k+1.
     For the M by N cyclic distribution this forces a row swap
     between processor rows.
+
+    The matrix is distributed according to the M by N block-cyclic
+    distribution with b by b blocks. For b=1 this is the M by N
+    cyclic distribution. If M=0 is given, the grid shape is chosen
+    by mpigrid_choose, based on the BSP cost of mpilu, and some
+    processors may be left idle.
+
+    If the block size nb is larger than 1, the blocked variant
+    mpilu_blocked is used, with panels of nb columns, and with the
+    row interchanges applied one at a time or batched per panel.
+    The pivots are then chosen by partial pivoting or by tournament
+    pivoting; for the latter, the pivots and hence L, U and pi may
+    differ from the values given above. With partial pivoting,
+    mpilu_dag can be used instead, which performs the same
+    computation as tasks with dynamic scheduling.
+    Otherwise, mpilu is used, with or without lookahead, and with
+    a broadcast algorithm for lk and uk chosen from
+        0 = MPI_Bcast, 1 = increasing ring,
+        2 = modified increasing ring, 3 = two rings,
+    or mpilu_tiled is used, which stores the local matrix in tiles
+    of nt by nt elements; the test matrix is then copied into
+    tile-major storage and copied back after the decomposition,
+    or mpiluf is used, which factors a single-precision copy of A.
+    In that case, the system below is solved by iterative refinement
+    with mpilu_refine, which computes the residuals with the original
+    matrix A in double precision, and the growth factor is not printed.
+    The maximum error of the computed L, U and pi compared to
+    the values given above is printed, together with the growth factor
+    max|U|/max|A| and max|L|, which indicate the stability.
+
+    Afterwards, the system AX = B with nrhs right-hand sides is solved
+    by mpilu_solve, for the solution X(i,c) = 1 + (i+c) mod 3,
+    and the time of the solve and the maximum error in X are printed.
+
+    In benchmark mode, as in the HPL benchmark, A and B are instead
+    pseudo-random matrices with elements in [-0.5,0.5], which every
+    processor generates for its own part, and the solution is checked
+    by the scaled residual
+        ||AX-B|| / (eps * (||A|| * ||X|| + ||B||) * n),
+    with the infinity norms and eps the unit roundoff, which should be
+    below RESTHRESH. The residual is computed by mpilu_residual on
+    a newly generated A, so that no extra copy of A is kept and no data
+    are gathered in one processor. The times of the generation,
+    decomposition, solve and check are printed, and the computing rate
+    with 2n^3/3 flops for the decomposition and solve together.
+    In benchmark mode, A can also be read from a binary file of n*n
+    doubles stored by rows, and L\U and pi can be written to binary
+    files, except with single precision, where the file name is
+    ignored with a message; every processor then reads or writes its
+    own part directly by MPI-IO, see mpilu_matrixio. The check then
+    reads A again.
 */
 
+#define GIGA 1000000000.0
+#define MAXIT 30 /* maximum number of refinement iterations */
+#define UNITROUNDOFF 1.1102230246251565e-16 /* 2^-53 */
+#define RESTHRESH 16.0 /* threshold of the scaled residual */
+#define STRLEN 256     /* maximum length of a file name */
+
+double hplmat(int i, int j) {
+  /* Return the element (i,j) of the random matrix [A B]
+     of benchmark mode, where column n+c is column c of B */
+  unsigned int x;
+
+  x = (unsigned int)i * 2654435761u ^ ((unsigned int)j * 40503u + 7u);
+  x ^= x >> 13;
+  x *= 0x5bd1e995u;
+  x ^= x >> 15;
+  x ^= (unsigned int)j * 2246822519u;
+  x ^= x >> 16;
+  return (x % 1000000) / 1000000.0 - 0.5;
+
+} /* end hplmat */
+
 int main(int argc, char **argv) {
 
-  int nloc(int p, int s, int n);
-  void mpilu(int M, int N, int s, int t, int n, int *pi, double **a);
-  int p, pid, M, N, s, t, n, nlr, nlc, i, j, iglob, jglob, *pi;
-  double **a, time0, time1;
+  int nloc(int p, int s, int n, int b);
+  int gindex(int p, int s, int i, int b);
+  struct mpigrid *mpigrid_create(int M, int N, MPI_Comm comm);
+  void mpigrid_choose(int p, int n, double g, double l, int *M, int *N);
+  void mpigrid_free(struct mpigrid *grid);
+  void mpilu(struct mpigrid *grid, int n, int b, int look, int bcast,
+             int *pi, double **a);
+  void mpilu_blocked(struct mpigrid *grid, int n, int b, int nb, int batch,
+                     int calu, int *pi, double **a);
+  void mpilu_dag(struct mpigrid *grid, int n, int b, int nb, int *pi,
+                 double **a);
+  double mpimaxabs(struct mpigrid *grid, int n, int b, int part, double **a);
+  void mpilu_solve(struct mpigrid *grid, int n, int b, int nrhs, int *pi,
+                   double **a, double **x);
+  void mpiluf(struct mpigrid *grid, int n, int b, int *pi, float **a);
+  void mpilu_tiled(struct mpigrid *grid, int n, int b, int nt, int *pi,
+                   double *a);
+  int tileoffset(int i, int j, int ntc, int nt);
+  void mpilu_untile(int m, int n, int nt, double *at, double **a);
+  int mpilu_refine(struct mpigrid *grid, int n, int b, int nrhs, int maxit,
+                   int *pi, double **a, float **af, double **bm, double **x);
+  void mpilu_residual(struct mpigrid *grid, int n, int b, int nrhs,
+                      double **a, double **x, double **bm, double **r);
+  double hplmat(int i, int j);
+  void mpilu_matrixio(struct mpigrid *grid, int n, int b, char *filename,
+                      int write, double **a);
+  void mpilu_writepi(struct mpigrid *grid, int n, int b, char *filename,
+                     int *pi);
+  int p, pid, provided, M, N, s, t, n, b, nb, batch, calu, dag, look, bcast,
+      mixed, nt, nrhs, hpl, nlr, nlc, i, j, c, iter, iglob, jglob, *pi;
+  double **a, *at, **x, **bm, **b0, **r, time0, time1, time2, time3, tgen,
+      tcheck, twrite, nflops, max_error, max_error_glob, amax, umax, lmax,
+      aij, g, l, *rowsum, *rowsum_glob, norm[4], norm_glob[4], resid;
+  float **af;
+  char infile[STRLEN], outfile[STRLEN], name[STRLEN + 8];
+  struct mpigrid *grid;
 
-  MPI_Init(&argc, &argv);
+  /* Only the master thread of each processor communicates */
+  MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+#ifdef _OPENMP
+  if (provided < MPI_THREAD_FUNNELED)
+    omp_set_num_threads(1);
+#endif
 
   MPI_Comm_size(MPI_COMM_WORLD, &p);
   MPI_Comm_rank(MPI_COMM_WORLD, &pid);
 
   if (pid == 0) {
-    printf("Please enter number of processor rows M:\n");
+    printf("Please enter number of processor rows M"
+           " (0 for automatic choice):\n");
     scanf("%d", &M);
-    printf("Please enter number of processor columns N:\n");
-    scanf("%d", &N);
-    if (M * N != p)
-      MPI_Abort(MPI_COMM_WORLD, -5);
+    if (M > 0) {
+      printf("Please enter number of processor columns N:\n");
+      scanf("%d", &N);
+      if (M * N > p)
+        MPI_Abort(MPI_COMM_WORLD, -5);
+    }
     printf("Please enter matrix size n:\n");
     scanf("%d", &n);
+    if (M <= 0) {
+      printf("Please enter BSP parameters g and l in flops"
+             " (0 0 for defaults):\n");
+      scanf("%lf %lf", &g, &l);
+      mpigrid_choose(p, n, g, l, &M, &N);
+      printf("Chosen processor grid is %d by %d", M, N);
+      printf(" with %d idle processors\n", p - M * N);
+    }
+    printf("Please enter distribution block size b:\n");
+    scanf("%d", &b);
+    if (b < 1)
+      MPI_Abort(MPI_COMM_WORLD, -12);
+    printf("Please enter block size nb:\n");
+    scanf("%d", &nb);
+    if (nb < 1)
+      MPI_Abort(MPI_COMM_WORLD, -12);
+    batch = calu = dag = look = mixed = FALSE;
+    bcast = nt = 0;
+    if (nb > 1) {
+      printf("Please enter 1 for batched row interchanges, 0 otherwise:\n");
+      scanf("%d", &batch);
+      printf("Please enter 1 for tournament pivoting, 0 otherwise:\n");
+      scanf("%d", &calu);
+      if (!calu) {
+        printf("Please enter 1 for dynamic task scheduling, 0 otherwise:\n");
+        scanf("%d", &dag);
+      }
+    } else {
+      printf("Please enter 1 for single precision with iterative "
+             "refinement, 0 otherwise:\n");
+      scanf("%d", &mixed);
+      if (!mixed) {
+        printf("Please enter tile size nt (0 for row-major storage):\n");
+        scanf("%d", &nt);
+      }
+      if (!mixed && nt <= 0) {
+        printf("Please enter 1 for lookahead, 0 otherwise:\n");
+        scanf("%d", &look);
+        printf("Please enter broadcast algorithm (0-3):\n");
+        scanf("%d", &bcast);
+        if (bcast < 0 || bcast > 3)
+          MPI_Abort(MPI_COMM_WORLD, -14);
+      }
+    }
+    printf("Please enter number of right-hand sides nrhs:\n");
+    scanf("%d", &nrhs);
+    if (nrhs < 1)
+      MPI_Abort(MPI_COMM_WORLD, -12);
+    hpl = FALSE;
+    printf("Please enter 1 for benchmark mode with a random matrix,"
+           " 0 otherwise:\n");
+    scanf("%d", &hpl);
+    sprintf(infile, "-");
+    sprintf(outfile, "-");
+    if (hpl) {
+      printf("Please enter file to read A from (- to generate A):\n");
+      scanf("%255s", infile);
+      printf("Please enter file name for L\\U and pi (- for none):\n");
+      scanf("%250s", outfile);
+      if (mixed && strcmp(outfile, "-") != 0) {
+        printf("L\\U is only computed in single precision,"
+               " so %s is not written\n", outfile);
+        sprintf(outfile, "-");
+      }
+    }
   }
   MPI_Bcast(&M, 1, MPI_INT, 0, MPI_COMM_WORLD);
   MPI_Bcast(&N, 1, MPI_INT, 0, MPI_COMM_WORLD);
   MPI_Bcast(&n, 1, MPI_INT, 0, MPI_COMM_WORLD);
+  MPI_Bcast(&b, 1, MPI_INT, 0, MPI_COMM_WORLD);
+  MPI_Bcast(&nb, 1, MPI_INT, 0, MPI_COMM_WORLD);
+  MPI_Bcast(&batch, 1, MPI_INT, 0, MPI_COMM_WORLD);
+  MPI_Bcast(&calu, 1, MPI_INT, 0, MPI_COMM_WORLD);
+  MPI_Bcast(&dag, 1, MPI_INT, 0, MPI_COMM_WORLD);
+  MPI_Bcast(&look, 1, MPI_INT, 0, MPI_COMM_WORLD);
+  MPI_Bcast(&bcast, 1, MPI_INT, 0, MPI_COMM_WORLD);
+  MPI_Bcast(&mixed, 1, MPI_INT, 0, MPI_COMM_WORLD);
+  MPI_Bcast(&nt, 1, MPI_INT, 0, MPI_COMM_WORLD);
+  MPI_Bcast(&nrhs, 1, MPI_INT, 0, MPI_COMM_WORLD);
+  MPI_Bcast(&hpl, 1, MPI_INT, 0, MPI_COMM_WORLD);
+  MPI_Bcast(infile, STRLEN, MPI_CHAR, 0, MPI_COMM_WORLD);
+  MPI_Bcast(outfile, STRLEN, MPI_CHAR, 0, MPI_COMM_WORLD);
 
-  /* Compute 2D processor numbering from 1D numbering */
-  s = pid % M; /* 0 <= s < M */
-  t = pid / M; /* 0 <= t < N */
+  /* Create the M by N processor grid, which determines
+     my 2D processor numbering */
+  grid = mpigrid_create(M, N, MPI_COMM_WORLD);
+  if (grid == NULL) { /* I am idle */
+    MPI_Finalize();
+    exit(0);
+  }
+  s = grid->s; /* 0 <= s < M */
+  t = grid->t; /* 0 <= t < N */
 
   /* Allocate and initialize matrix */
-  nlr = nloc(M, s, n); /* number of local rows */
-  nlc = nloc(N, t, n); /* number of local columns */
+  nlr = nloc(M, s, n, b); /* number of local rows */
+  nlc = nloc(N, t, n, b); /* number of local columns */
   a = matallocd(nlr, nlc);
   pi = vecalloci(nlr);
+  x = matallocd(nlr, nrhs);
 
   if (s == 0 && t == 0) {
     printf("LU decomposition of %d by %d matrix\n", n, n);
-    printf("using the %d by %d cyclic distribution\n", M, N);
+    if (b > 1) {
+      printf("using the %d by %d block-cyclic distribution", M, N);
+      printf(" with %d by %d blocks\n", b, b);
+    } else {
+      printf("using the %d by %d cyclic distribution\n", M, N);
+    }
+#ifdef _OPENMP
+    printf("with %d threads per processor\n", omp_get_max_threads());
+#endif
+    if (nb > 1)
+      printf("and panels of %d columns\n", nb);
+    if (batch)
+      printf("with batched row interchanges\n");
+    if (dag)
+      printf("with dynamic task scheduling\n");
+    if (calu)
+      printf("with tournament pivoting\n");
+    if (look)
+      printf("with lookahead\n");
+    if (mixed)
+      printf("in single precision\n");
+    if (nt > 0)
+      printf("with %d by %d tiles\n", nt, nt);
+    if (hpl && strcmp(infile, "-") != 0)
+      printf("in benchmark mode with matrix %s\n", infile);
+    else if (hpl)
+      printf("in benchmark mode with a random matrix\n");
   }
-  for (i = 0; i < nlr; i++) {
-    iglob = i * M + s;           /* Global row index in A */
-    iglob = (iglob - 1 + n) % n; /* Global row index in B */
-    for (j = 0; j < nlc; j++) {
-      jglob = j * N + t; /* Global column index in A and B */
-      a[i][j] = (iglob <= jglob ? 0.5 * iglob + 1 : 0.5 * (jglob + 1));
+  MPI_Barrier(grid->comm);
+  tgen = MPI_Wtime();
+  b0 = NULL;
+  if (hpl) {
+    /* Generate my part of A and my rows of B, and keep a copy of B */
+    b0 = matallocd(nlr, nrhs);
+    if (strcmp(infile, "-") != 0)
+      mpilu_matrixio(grid, n, b, infile, FALSE, a);
+    for (i = 0; i < nlr; i++) {
+      iglob = gindex(M, s, i, b);
+      if (strcmp(infile, "-") == 0) {
+        for (j = 0; j < nlc; j++)
+          a[i][j] = hplmat(iglob, gindex(N, t, j, b));
+      }
+      for (c = 0; c < nrhs; c++)
+        x[i][c] = b0[i][c] = hplmat(iglob, n + c);
+    }
+  } else {
+    for (i = 0; i < nlr; i++) {
+      iglob = gindex(M, s, i, b);  /* Global row index in A */
+      iglob = (iglob - 1 + n) % n; /* Global row index in B */
+      for (j = 0; j < nlc; j++) {
+        jglob = gindex(N, t, j, b); /* Global column index in A and B */
+        a[i][j] = (iglob <= jglob ? 0.5 * iglob + 1 : 0.5 * (jglob + 1));
+      }
+    }
+
+    /* Compute my rows of B = AX, for all columns of A */
+    for (i = 0; i < nlr; i++) {
+      iglob = (gindex(M, s, i, b) - 1 + n) % n;
+      for (c = 0; c < nrhs; c++)
+        x[i][c] = 0.0;
+      for (jglob = 0; jglob < n; jglob++) {
+        aij = (iglob <= jglob ? 0.5 * iglob + 1 : 0.5 * (jglob + 1));
+        for (c = 0; c < nrhs; c++)
+          x[i][c] += aij * (1 + (jglob + c) % 3);
+      }
     }
   }
+  MPI_Barrier(grid->comm);
+  tgen = MPI_Wtime() - tgen;
 
+  amax = mpimaxabs(grid, n, b, 0, a);
+  at = NULL;
+  if (nt > 0) {
+    /* Copy A into tile-major storage */
+    at = vecallocd(((nlr + nt - 1) / nt) * ((nlc + nt - 1) / nt) * nt * nt);
+    for (i = 0; i < nlr; i++) {
+      for (j = 0; j < nlc; j++)
+        at[tileoffset(i, j, (nlc + nt - 1) / nt, nt)] = a[i][j];
+    }
+  }
+  af = NULL;
+  if (mixed) {
+    af = matallocf(nlr, nlc);
+    for (i = 0; i < nlr; i++) {
+      for (j = 0; j < nlc; j++)
+        af[i][j] = (float)a[i][j];
+    }
+  }
   if (s == 0 && t == 0)
     printf("Start of LU decomposition\n");
 
-  MPI_Barrier(MPI_COMM_WORLD);
+  MPI_Barrier(grid->comm);
   time0 = MPI_Wtime();
 
-  mpilu(M, N, s, t, n, pi, a);
-  MPI_Barrier(MPI_COMM_WORLD);
+  if (nb > 1) {
+    if (dag)
+      mpilu_dag(grid, n, b, nb, pi, a);
+    else
+      mpilu_blocked(grid, n, b, nb, batch, calu, pi, a);
+  } else if (mixed) {
+    mpiluf(grid, n, b, pi, af);
+  } else if (nt > 0) {
+    mpilu_tiled(grid, n, b, nt, pi, at);
+  } else {
+    mpilu(grid, n, b, look, bcast, pi, a);
+  }
+  MPI_Barrier(grid->comm);
   time1 = MPI_Wtime();
 
+  if (nt > 0) {
+    mpilu_untile(nlr, nlc, nt, at, a);
+    vecfreed(at);
+  }
+
+  /* Compute the growth factor and the accuracy */
+  umax = lmax = 0.0;
+  if (!mixed) {
+    umax = mpimaxabs(grid, n, b, 1, a);
+    lmax = mpimaxabs(grid, n, b, 2, a);
+  }
+  max_error = 0.0;
+  for (i = 0; i < nlr; i++) {
+    iglob = gindex(M, s, i, b);
+    if (t == 0)
+      max_error = MAX(max_error, fabs((double)(pi[i] - (iglob + 1) % n)));
+    for (j = 0; j < nlc; j++) {
+      jglob = gindex(N, t, j, b);
+      max_error = MAX(max_error, fabs((mixed ? af[i][j] : a[i][j]) -
+                                      (iglob > jglob ? 0.5 : 1.0)));
+    }
+  }
+  MPI_Reduce(&max_error, &max_error_glob, 1, MPI_DOUBLE, MPI_MAX, 0,
+             grid->comm);
+
   if (s == 0 && t == 0) {
     printf("End of LU decomposition\n");
     printf("This took only %.6lf seconds.\n", time1 - time0);
+    nflops = 2.0 * n * (double)n * n / 3.0;
+    printf("Computing rate = %.3lf Gflop/s\n", nflops / (GIGA * (time1 - time0)));
+    if (!mixed)
+      printf("Growth factor max|U|/max|A| = %e, max|L| = %e\n",
+             umax / amax, lmax);
+    if (!hpl)
+      printf("Maximum error in L, U and pi = %e\n", max_error_glob);
+    fflush(stdout);
+  }
+
+  /* Solve AX = B */
+  bm = NULL;
+  iter = 0;
+  if (mixed) {
+    bm = matallocd(nlr, nrhs);
+    for (i = 0; i < nlr; i++) {
+      for (c = 0; c < nrhs; c++)
+        bm[i][c] = x[i][c];
+    }
+  }
+  MPI_Barrier(grid->comm);
+  time2 = MPI_Wtime();
+  if (mixed) {
+    iter = mpilu_refine(grid, n, b, nrhs, MAXIT, pi, a, af, bm, x);
+  } else {
+    mpilu_solve(grid, n, b, nrhs, pi, a, x);
+  }
+  MPI_Barrier(grid->comm);
+  time3 = MPI_Wtime();
+
+  max_error = 0.0;
+  for (i = 0; i < nlr; i++) {
+    iglob = gindex(M, s, i, b);
+    for (c = 0; c < nrhs; c++)
+      max_error = MAX(max_error, fabs(x[i][c] - (1 + (iglob + c) % 3)));
+  }
+  MPI_Reduce(&max_error, &max_error_glob, 1, MPI_DOUBLE, MPI_MAX, 0,
+             grid->comm);
+
+  if (s == 0 && t == 0) {
+    printf("Solve with %d right-hand sides took %.6lf seconds.\n", nrhs,
+           time3 - time2);
+    if (mixed)
+      printf("Iterative refinement took %d iterations%s\n", MIN(iter, MAXIT),
+             (iter > MAXIT ? " and did not converge" : ""));
+    if (!hpl)
+      printf("Maximum error in X = %e\n", max_error_glob);
+    printf("Total time of decomposition and solve = %.6lf seconds\n",
+           time1 - time0 + time3 - time2);
     fflush(stdout);
   }
 
+  if (hpl && strcmp(outfile, "-") != 0) {
+    /* Write L\U and pi, before A is overwritten by the check */
+    MPI_Barrier(grid->comm);
+    twrite = MPI_Wtime();
+    sprintf(name, "%s.pi", outfile);
+    mpilu_matrixio(grid, n, b, outfile, TRUE, a);
+    mpilu_writepi(grid, n, b, name, pi);
+    MPI_Barrier(grid->comm);
+    if (s == 0 && t == 0)
+      printf("Writing L\\U to %s and pi to %s took %.6lf seconds.\n",
+             outfile, name, MPI_Wtime() - twrite);
+  }
+
+  if (hpl) {
+    /* Generate or read A again and compute R = B - AX. X, B and R are
+       replicated over the processor columns, so that only the
+       row sums of |A| need to be added within a processor row. */
+    MPI_Barrier(grid->comm);
+    tcheck = MPI_Wtime();
+    r = matallocd(nlr, nrhs);
+    if (strcmp(infile, "-") != 0) {
+      mpilu_matrixio(grid, n, b, infile, FALSE, a);
+    } else {
+      for (i = 0; i < nlr; i++) {
+        iglob = gindex(M, s, i, b);
+        for (j = 0; j < nlc; j++)
+          a[i][j] = hplmat(iglob, gindex(N, t, j, b));
+      }
+    }
+    mpilu_residual(grid, n, b, nrhs, a, x, b0, r);
+
+    /* norm = local maxima of ||R||, ||X||, ||B|| and row sums of |A| */
+    norm[0] = norm[1] = norm[2] = 0.0;
+    for (i = 0; i < nlr; i++) {
+      for (c = 0; c < nrhs; c++) {
+        norm[0] = MAX(norm[0], fabs(r[i][c]));
+        norm[1] = MAX(norm[1], fabs(x[i][c]));
+        norm[2] = MAX(norm[2], fabs(b0[i][c]));
+      }
+    }
+    rowsum = vecallocd(nlr);
+    rowsum_glob = vecallocd(nlr);
+    for (i = 0; i < nlr; i++) {
+      rowsum[i] = 0.0;
+      for (j = 0; j < nlc; j++)
+        rowsum[i] += fabs(a[i][j]);
+    }
+    MPI_Allreduce(rowsum, rowsum_glob, nlr, MPI_DOUBLE, MPI_SUM,
+                  grid->row_comm);
+    norm[3] = 0.0;
+    for (i = 0; i < nlr; i++)
+      norm[3] = MAX(norm[3], rowsum_glob[i]);
+    vecfreed(rowsum_glob);
+    vecfreed(rowsum);
+    MPI_Allreduce(norm, norm_glob, 4, MPI_DOUBLE, MPI_MAX, grid->comm);
+    resid = norm_glob[0] / (UNITROUNDOFF *
+                            (norm_glob[3] * norm_glob[1] + norm_glob[2]) * n);
+    MPI_Barrier(grid->comm);
+    tcheck = MPI_Wtime() - tcheck;
+
+    if (s == 0 && t == 0) {
+      printf("||AX-B||/(eps*(||A||*||X||+||B||)*n) = %e ... %s\n", resid,
+             (resid < RESTHRESH ? "PASSED" : "FAILED"));
+      printf("Time of generation    = %.6lf seconds\n", tgen);
+      printf("Time of decomposition = %.6lf seconds\n", time1 - time0);
+      printf("Time of solve         = %.6lf seconds\n", time3 - time2);
+      printf("Time of check         = %.6lf seconds\n", tcheck);
+      printf("Benchmark rate = %.3lf Gflop/s\n",
+             nflops / (GIGA * (time1 - time0 + time3 - time2)));
+      fflush(stdout);
+    }
+    matfreed(r);
+    matfreed(b0);
+  }
+
   /* printf("\nThe output permutation is:\n");
   if (t == 0) {
     for (i = 0; i < nlr; i++) {
-      iglob = i * M + s;
+      iglob = gindex(M, s, i, b);
       printf("i=%d, pi=%d, proc=(%d,%d)\n", iglob, pi[i], s, t);
     }
     fflush(stdout);
   } */
-  MPI_Barrier(MPI_COMM_WORLD);
+  MPI_Barrier(grid->comm);
 
   /* if (s == 0 && t == 0) {
     printf("\nThe output matrix is:\n");
     fflush(stdout);
   }
   for (i = 0; i < nlr; i++) {
-    iglob = i * M + s;
+    iglob = gindex(M, s, i, b);
     for (j = 0; j < nlc; j++) {
-      jglob = j * N + t;
+      jglob = gindex(N, t, j, b);
       printf("i=%d, j=%d, a=%f, proc=(%d,%d)\n", iglob, jglob, a[i][j], s, t);
     }
   } */
 
+  matfreed(bm);
+  matfreef(af);
+  matfreed(x);
   vecfreei(pi);
   matfreed(a);
+  mpigrid_free(grid);
   MPI_Finalize();
 
   exit(0);
@@ -0,0 +1,263 @@
+#include "mpiedupack.h"
+
+#define EPS 1.0e-15
+
+/* A band matrix A with kl subdiagonals and ku superdiagonals is stored
+   by columns, in the block-cyclic distribution of the columns over the
+   p processors of a communicator with block size b. Processor q stores
+   its nloc(p,q,n,b) local columns as the rows of an nloc(p,q,n,b)
+   by 2*kl+ku+1 matrix ab, allocated by matallocd, with element A(i,j)
+   of local column jl = lindex(p,j,b) in ab[jl][kl+ku+i-j], as in the
+   band storage of LAPACK. The first kl elements of every column
+   must be zero on input; they hold the fill of U that is caused by
+   the row swaps of partial pivoting. */
+
+void mpilu_band(int n, int kl, int ku, int b, double **ab, int *piv,
+                MPI_Comm comm) {
+  /* Compute the LU decomposition with partial pivoting of the n by n
+     band matrix A, stored in ab as described above. On output, ab
+     contains U, with kl+ku superdiagonals, and the multipliers of L,
+     in the same positions as the elements of A. piv[jl] is the row
+     that was swapped with row j = gindex(p,q,jl,b) in stage j,
+     as in LAPACK, so that L is not permuted.
+     Program text for processor q.
+
+     The columns are factored in panels of at most b columns, the
+     blocks of the distribution, so that every panel has one owner.
+     The owner factors the panel and sends its pivots and multipliers
+     only to the owners of the columns within the band to the right
+     of the panel, j < k1+kl+ku, which apply the row swaps and
+     update their columns. Every processor handles the panels
+     in increasing order and receives a panel before it is needed,
+     which gives a pipeline: while the owner of the next panel
+     factors it, the other processors still update their columns
+     with the previous panels. The sends are nonblocking, so that
+     the owner of a panel never waits for its successors.
+     Every panel is sent to at most min((kl+ku)/b+1,p) processors,
+     as b*(kl+1) words. The work is about 2n*kl*(kl+ku)/p flops if
+     the band is wide enough to keep all processors busy, i.e.
+     (kl+ku)/b >= p-1, and the memory is n*(2kl+ku+1)/p words
+     per processor.
+  */
+
+  int nloc(int p, int s, int n, int b);
+  int lindex(int p, int k, int b);
+  int gindex(int p, int s, int i, int b);
+  int p, q, w, J, k0, k1, kb, r, c1, mine, k, i, imax, rr, c, jl, len, B,
+      dest, nsend, nreq;
+  double *col, *cc, *lk, *sbuf, *rbuf, *L, max, tmp, ukc;
+
+  MPI_Request *request;
+
+  MPI_Comm_size(comm, &p);
+  MPI_Comm_rank(comm, &q);
+  w = kl + ku; /* position of the diagonal in a column */
+
+  sbuf = vecallocd(b * (kl + 1));
+  rbuf = vecallocd(b * (kl + 1));
+  request = (MPI_Request *)malloc(p * sizeof(MPI_Request));
+  if (request == NULL)
+    MPI_Abort(MPI_COMM_WORLD, -13);
+  nreq = 0;
+
+  for (J = 0; J * b < n; J++) {
+    k0 = J * b;
+    k1 = MIN(k0 + b, n);
+    kb = k1 - k0;
+    r = J % p;           /* owner of the panel */
+    c1 = MIN(n, k1 + w); /* the panel changes columns k1 <= j < c1 */
+    mine = (nloc(p, q, c1, b) > nloc(p, q, k1, b));
+    L = NULL;
+
+    if (q == r) {
+      /****** Superstep 0. Factor the panel ******/
+      /* The buffer may only be changed when the sends are done */
+      MPI_Waitall(nreq, request, MPI_STATUSES_IGNORE);
+      nreq = 0;
+
+      for (k = k0; k < k1; k++) {
+        col = ab[lindex(p, k, b)];
+        imax = MIN(n - 1, k + kl);
+        rr = k;
+        max = 0.0;
+        for (i = k; i <= imax; i++) {
+          if (fabs(col[w + i - k]) > max) {
+            max = fabs(col[w + i - k]);
+            rr = i;
+          }
+        }
+        if (max <= EPS)
+          MPI_Abort(MPI_COMM_WORLD, -6);
+        piv[lindex(p, k, b)] = rr;
+
+        /* Swap rows k and rr and update the panel columns
+           within the band of row k */
+        for (c = k; c < MIN(k1, k + w + 1); c++) {
+          cc = ab[lindex(p, c, b)];
+          if (rr != k) {
+            tmp = cc[w + k - c];
+            cc[w + k - c] = cc[w + rr - c];
+            cc[w + rr - c] = tmp;
+          }
+          if (c == k) {
+            for (i = k + 1; i <= imax; i++)
+              col[w + i - k] /= col[w];
+          } else {
+            ukc = cc[w + k - c];
+            for (i = k + 1; i <= imax; i++)
+              cc[w + i - c] -= col[w + i - k] * ukc;
+          }
+        }
+      }
+
+      /* Pack the pivot and the kl multipliers of every column */
+      len = 0;
+      for (k = k0; k < k1; k++) {
+        col = ab[lindex(p, k, b)];
+        sbuf[len++] = (double)piv[lindex(p, k, b)];
+        for (i = 1; i <= kl; i++)
+          sbuf[len++] = (k + i < n ? col[w + i] : 0.0);
+      }
+
+      /* Send to the other owners of columns k1 <= j < c1 */
+      if (c1 > k1) {
+        nsend = MIN((c1 - 1) / b - k1 / b + 1, p);
+        for (B = k1 / b; B < k1 / b + nsend; B++) {
+          dest = B % p;
+          if (dest != q)
+            MPI_Isend(sbuf, len, MPI_DOUBLE, dest, 0, comm,
+                      &request[nreq++]);
+        }
+      }
+      L = sbuf;
+    } else if (mine) {
+      MPI_Recv(rbuf, kb * (kl + 1), MPI_DOUBLE, r, 0, comm,
+               MPI_STATUS_IGNORE);
+      L = rbuf;
+    }
+
+    /****** Superstep 1. Update my columns within the band ******/
+    if (mine) {
+      for (jl = nloc(p, q, k1, b); jl < nloc(p, q, c1, b); jl++) {
+        c = gindex(p, q, jl, b);
+        cc = ab[jl];
+        /* Rows k < c-w are zero in column c, also after the swaps */
+        for (k = MAX(k0, c - w); k < k1; k++) {
+          lk = &L[(k - k0) * (kl + 1)];
+          rr = (int)lk[0];
+          if (rr != k) {
+            tmp = cc[w + k - c];
+            cc[w + k - c] = cc[w + rr - c];
+            cc[w + rr - c] = tmp;
+          }
+          ukc = cc[w + k - c];
+          imax = MIN(kl, n - 1 - k);
+          for (i = 1; i <= imax; i++)
+            cc[w + k + i - c] -= lk[i] * ukc;
+        }
+      }
+    }
+  }
+  MPI_Waitall(nreq, request, MPI_STATUSES_IGNORE);
+
+  free(request);
+  vecfreed(rbuf);
+  vecfreed(sbuf);
+
+} /* end mpilu_band */
+
+void mpilu_bandsolve(int n, int kl, int ku, int b, double **ab, int *piv,
+                     double *x, MPI_Comm comm) {
+  /* Solve the system Ax = y, using the LU decomposition of the band
+     matrix A computed by mpilu_band. On input, x is the right-hand
+     side y and on output the solution x, both of length n and
+     replicated on all processors of comm.
+     Program text for processor q.
+
+     The forward substitution applies the panels of L in increasing
+     order. The owner of a panel receives the rows k0 <= i < k0+kl
+     of the partly transformed x from the owner of the previous panel,
+     applies the swaps and multipliers of its panel, and sends the
+     rows k1 <= i < k1+kl to the owner of the next panel.
+     The backward substitution uses the columns of U, from right to
+     left: the owner of a panel receives the sums d(i) of U(i,j)x(j)
+     over the columns j >= k1 for the kl+ku rows above k1, computes
+     x(j) for its panel and passes the sums for the rows above k0
+     on to the owner of the previous panel.
+     The solution is finally replicated by one reduction.
+  */
+
+  int nloc(int p, int s, int n, int b);
+  int lindex(int p, int k, int b);
+  int gindex(int p, int s, int i, int b);
+  int p, q, w, J, nJ, k0, k1, k, i, c, lo, rr, nlc, jl;
+  double *col, *d, *y, tmp;
+
+  MPI_Comm_size(comm, &p);
+  MPI_Comm_rank(comm, &q);
+  w = kl + ku;
+  nJ = (n + b - 1) / b; /* number of panels */
+
+  /****** Forward substitution Lz = Py ******/
+  for (J = 0; J < nJ; J++) {
+    if (J % p != q)
+      continue;
+    k0 = J * b;
+    k1 = MIN(k0 + b, n);
+    if (J > 0 && (J - 1) % p != q)
+      MPI_Recv(&x[k0], MIN(kl, n - k0), MPI_DOUBLE, (J - 1) % p, 1, comm,
+               MPI_STATUS_IGNORE);
+    for (k = k0; k < k1; k++) {
+      col = ab[lindex(p, k, b)];
+      rr = piv[lindex(p, k, b)];
+      if (rr != k) {
+        tmp = x[k];
+        x[k] = x[rr];
+        x[rr] = tmp;
+      }
+      for (i = 1; i <= MIN(kl, n - 1 - k); i++)
+        x[k + i] -= col[w + i] * x[k];
+    }
+    if (J + 1 < nJ && (J + 1) % p != q)
+      MPI_Send(&x[k1], MIN(kl, n - k1), MPI_DOUBLE, (J + 1) % p, 1, comm);
+  }
+
+  /****** Backward substitution Ux = z ******/
+  d = vecallocd(n);
+  for (i = 0; i < n; i++)
+    d[i] = 0.0;
+  for (J = nJ - 1; J >= 0; J--) {
+    if (J % p != q)
+      continue;
+    k0 = J * b;
+    k1 = MIN(k0 + b, n);
+    lo = MAX(0, k1 - w);
+    if (J + 1 < nJ && (J + 1) % p != q)
+      MPI_Recv(&d[lo], k1 - lo, MPI_DOUBLE, (J + 1) % p, 2, comm,
+               MPI_STATUS_IGNORE);
+    for (c = k1 - 1; c >= k0; c--) {
+      col = ab[lindex(p, c, b)];
+      x[c] = (x[c] - d[c]) / col[w];
+      for (i = MAX(0, c - w); i < c; i++)
+        d[i] += col[w + i - c] * x[c];
+    }
+    lo = MAX(0, k0 - w);
+    if (J > 0 && (J - 1) % p != q)
+      MPI_Send(&d[lo], k0 - lo, MPI_DOUBLE, (J - 1) % p, 2, comm);
+  }
+
+  /****** Replicate the solution ******/
+  y = vecallocd(n);
+  for (i = 0; i < n; i++)
+    y[i] = 0.0;
+  nlc = nloc(p, q, n, b);
+  for (jl = 0; jl < nlc; jl++) {
+    c = gindex(p, q, jl, b);
+    y[c] = x[c];
+  }
+  MPI_Allreduce(y, x, n, MPI_DOUBLE, MPI_SUM, comm);
+
+  vecfreed(y);
+  vecfreed(d);
+
+} /* end mpilu_bandsolve */
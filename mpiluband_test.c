@@ -0,0 +1,220 @@
+#include "mpiedupack.h"
+
+/*  This is a test program which uses mpilu_band to decompose an n by n
+    band matrix A with kl subdiagonals and ku superdiagonals, with its
+    columns distributed block-cyclically over p processors with block
+    size b, and mpilu_bandsolve to solve Ax = y. The elements of A
+    within the band are pseudo-random numbers in [-1,1], computed from
+    the global indices, plus d/2 on the diagonal and, if kl > 0,
+    d on the subdiagonal in the even columns, with d = 8(kl+ku+1).
+    Thus A consists of dominant 2 by 2 blocks [d/2 0; d d/2] plus
+    a small perturbation, so that it is well-conditioned, while
+    partial pivoting has to swap rows in every even column.
+    The exact solution is x(i) = 1 + (i mod 7), and y = Ax is computed
+    by every processor.
+
+    The time and approximate computing rate of mpilu_band, based on
+    2n*kl*(kl+ku) flops, and the time of mpilu_bandsolve are printed,
+    together with the maximum error of the solution and the maximum
+    residual |y - Ax|. For n <= CHECKMAX, the factors are also
+    gathered on processor 0, which prints the number of row swaps
+    and the maximum error in A - P0 L0 P1 L1 ... U, the product
+    of the swaps and the elimination steps in the LAPACK order.
+*/
+
+#define CHECKMAX 20000
+
+double bandmat(int i, int j, int kl, int ku) {
+  /* Return the element (i,j) of the test matrix A within the band */
+  unsigned int x;
+  double a, d;
+
+  x = (unsigned int)i * 2654435761u ^ ((unsigned int)j * 40503u + 7u);
+  x ^= x >> 13;
+  x *= 0x5bd1e995u;
+  x ^= x >> 15;
+  a = (x % 10000) / 5000.0 - 1.0;
+  d = 8.0 * (kl + ku + 1);
+  if (i == j)
+    a += 0.5 * d;
+  else if (i == j + 1 && j % 2 == 0)
+    a += d;
+  return a;
+
+} /* end bandmat */
+
+int main(int argc, char **argv) {
+
+  int nloc(int p, int s, int n, int b);
+  int gindex(int p, int s, int i, int b);
+  double bandmat(int i, int j, int kl, int ku);
+  void mpilu_band(int n, int kl, int ku, int b, double **ab, int *piv,
+                  MPI_Comm comm);
+  void mpilu_bandsolve(int n, int kl, int ku, int b, double **ab, int *piv,
+                       double *x, MPI_Comm comm);
+  int p, pid, n, kl, ku, b, nlc, ld, jl, i, j, k, q, lo, hi, nq, nswap,
+      *piv, *fpiv, *pos, *cnt, *displ;
+  double **ab, **fab, *x, *y, *z, time0, time1, time2, error, res, sum,
+      errlu;
+
+  MPI_Init(&argc, &argv);
+  MPI_Comm_size(MPI_COMM_WORLD, &p);
+  MPI_Comm_rank(MPI_COMM_WORLD, &pid);
+
+  if (pid == 0) {
+    printf("Please enter matrix size n:\n");
+    scanf("%d", &n);
+    printf("Please enter number of subdiagonals kl and superdiagonals ku:\n");
+    scanf("%d %d", &kl, &ku);
+    if (n < 1 || kl < 0 || ku < 0)
+      MPI_Abort(MPI_COMM_WORLD, -12);
+    printf("Please enter distribution block size b:\n");
+    scanf("%d", &b);
+    if (b < 1)
+      MPI_Abort(MPI_COMM_WORLD, -12);
+  }
+  MPI_Bcast(&n, 1, MPI_INT, 0, MPI_COMM_WORLD);
+  MPI_Bcast(&kl, 1, MPI_INT, 0, MPI_COMM_WORLD);
+  MPI_Bcast(&ku, 1, MPI_INT, 0, MPI_COMM_WORLD);
+  MPI_Bcast(&b, 1, MPI_INT, 0, MPI_COMM_WORLD);
+
+  nlc = nloc(p, pid, n, b);
+  ld = 2 * kl + ku + 1;
+  ab = matallocd(nlc, ld);
+  piv = vecalloci(nlc);
+  x = vecallocd(n);
+  y = vecallocd(n);
+
+  for (jl = 0; jl < nlc; jl++) {
+    j = gindex(p, pid, jl, b);
+    for (i = 0; i < ld; i++)
+      ab[jl][i] = 0.0;
+    for (i = MAX(0, j - ku); i <= MIN(n - 1, j + kl); i++)
+      ab[jl][kl + ku + i - j] = bandmat(i, j, kl, ku);
+  }
+
+  /* Right-hand side y = Ax */
+  for (i = 0; i < n; i++) {
+    y[i] = 0.0;
+    for (j = MAX(0, i - kl); j <= MIN(n - 1, i + ku); j++)
+      y[i] += bandmat(i, j, kl, ku) * (1.0 + j % 7);
+    x[i] = y[i];
+  }
+
+  if (pid == 0)
+    printf("Band LU of %d by %d matrix with kl = %d, ku = %d, b = %d\n", n,
+           n, kl, ku, b);
+
+  MPI_Barrier(MPI_COMM_WORLD);
+  time0 = MPI_Wtime();
+  mpilu_band(n, kl, ku, b, ab, piv, MPI_COMM_WORLD);
+  MPI_Barrier(MPI_COMM_WORLD);
+  time1 = MPI_Wtime();
+  mpilu_bandsolve(n, kl, ku, b, ab, piv, x, MPI_COMM_WORLD);
+  MPI_Barrier(MPI_COMM_WORLD);
+  time2 = MPI_Wtime();
+
+  error = res = 0.0;
+  for (i = 0; i < n; i++) {
+    error = MAX(error, fabs(x[i] - (1.0 + i % 7)));
+    sum = y[i];
+    for (j = MAX(0, i - kl); j <= MIN(n - 1, i + ku); j++)
+      sum -= bandmat(i, j, kl, ku) * x[j];
+    res = MAX(res, fabs(sum));
+  }
+
+  nswap = 0;
+  errlu = 0.0;
+  /* Gather the factors on processor 0 and check A = P0 L0 ... U */
+  if (n <= CHECKMAX) {
+    if (pid == 0) {
+      fab = matallocd(n, ld);
+      fpiv = vecalloci(n);
+      cnt = vecalloci(p);
+      displ = vecalloci(p);
+      for (q = 0; q < p; q++) {
+        cnt[q] = nloc(p, q, n, b);
+        displ[q] = (q == 0 ? 0 : displ[q - 1] + cnt[q - 1]);
+      }
+      MPI_Gatherv(piv, nlc, MPI_INT, fpiv, cnt, displ, MPI_INT, 0,
+                  MPI_COMM_WORLD);
+      for (q = 0; q < p; q++) {
+        cnt[q] *= ld;
+        displ[q] *= ld;
+      }
+      MPI_Gatherv((nlc > 0 ? ab[0] : NULL), nlc * ld, MPI_DOUBLE, fab[0],
+                  cnt, displ, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+      vecfreei(displ);
+      vecfreei(cnt);
+
+      /* The gathered columns of processor q are its local columns,
+         in order; pos[j] is the position of global column j */
+      z = vecallocd(n);
+      pos = vecalloci(n);
+      jl = 0;
+      for (q = 0; q < p; q++) {
+        nq = nloc(p, q, n, b);
+        for (i = 0; i < nq; i++)
+          pos[gindex(p, q, i, b)] = jl++;
+      }
+
+      /* Column j of A is P0 L0 P1 L1 ... U(:,j). Only the steps
+         k >= j-2kl-ku can change the nonzeros, in rows lo..hi */
+      for (i = 0; i < n; i++)
+        z[i] = 0.0;
+      for (j = 0; j < n; j++) {
+        if (fpiv[pos[j]] != j)
+          nswap++;
+        lo = MAX(0, j - 2 * kl - ku);
+        hi = MIN(n - 1, j + kl);
+        for (i = MAX(0, j - kl - ku); i <= j; i++)
+          z[i] = fab[pos[j]][kl + ku + i - j];
+        for (k = j; k >= lo; k--) {
+          for (i = k + 1; i <= MIN(n - 1, k + kl); i++)
+            z[i] += fab[pos[k]][kl + ku + i - k] * z[k];
+          i = fpiv[pos[k]];
+          sum = z[k];
+          z[k] = z[i];
+          z[i] = sum;
+        }
+        for (i = lo; i <= hi; i++) {
+          sum = (i >= j - ku ? bandmat(i, j, kl, ku) : 0.0);
+          errlu = MAX(errlu, fabs(z[i] - sum));
+          z[i] = 0.0;
+        }
+      }
+      vecfreei(pos);
+      vecfreed(z);
+      vecfreei(fpiv);
+      matfreed(fab);
+    } else {
+      MPI_Gatherv(piv, nlc, MPI_INT, NULL, NULL, NULL, MPI_INT, 0,
+                  MPI_COMM_WORLD);
+      MPI_Gatherv((nlc > 0 ? ab[0] : NULL), nlc * ld, MPI_DOUBLE, NULL,
+                  NULL, NULL, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    }
+  }
+
+  if (pid == 0) {
+    printf("Decomposition took %.6lf seconds, rate = %.3lf Gflop/s\n",
+           time1 - time0,
+           2.0 * n * (double)kl * (kl + ku) / ((time1 - time0) * 1.0e9));
+    printf("Solve took %.6lf seconds.\n", time2 - time1);
+    printf("Maximum error in x = %e\n", error);
+    printf("Maximum residual = %e\n", res);
+    if (n <= CHECKMAX) {
+      printf("Number of row swaps = %d\n", nswap);
+      printf("Maximum error in A - P0 L0 ... U = %e\n", errlu);
+    }
+  }
+
+  vecfreed(y);
+  vecfreed(x);
+  vecfreei(piv);
+  matfreed(ab);
+
+  MPI_Finalize();
+
+  exit(0);
+
+} /* end main */
@@ -0,0 +1,346 @@
+#include "mpiedupack.h"
+
+#define EPS 1.0e-15
+#define BATCHNB 32 /* panel width of lu_seq */
+#define VB 8       /* number of matrices factored together by lu_vec */
+#define VTINY 24   /* matrices with n <= VTINY are factored by lu_vec */
+
+int lu_seq(int n, double *a, int *pi) {
+  /* This sequential function computes the LU decomposition with
+     partial pivoting of the n by n matrix A, stored by rows in a,
+     such that A(pi(i),j) = (LU)(i,j), and stores L\U in a.
+     It returns 0, or k+1 if the pivot of column k is at most EPS
+     in absolute value; the decomposition then stops at column k.
+     It uses panels of BATCHNB columns: a panel is factored with row
+     swaps over the whole width of A, then the rows of U to the right
+     of the panel are computed, and the trailing matrix is updated
+     by mm_sub. For n <= 512, the matrix fits in the cache. */
+
+  void mm_sub(int m, int n, int kb, double **l, double **u, double **c,
+              int jc);
+  double **L, **U, **C, max, tmp, *x, *y;
+  int k0, kb, k, i, j, r, itmp, info;
+
+  L = (double **)malloc(MAX(n, 1) * sizeof(double *));
+  U = (double **)malloc(MAX(n, 1) * sizeof(double *));
+  C = (double **)malloc(MAX(n, 1) * sizeof(double *));
+  if (L == NULL || U == NULL || C == NULL)
+    MPI_Abort(MPI_COMM_WORLD, -13);
+
+  for (i = 0; i < n; i++)
+    pi[i] = i;
+
+  info = 0;
+  for (k0 = 0; k0 < n; k0 += BATCHNB) {
+    kb = MIN(BATCHNB, n - k0);
+
+    /* Factor the panel of columns k0 <= k < k0+kb */
+    for (k = k0; k < k0 + kb; k++) {
+      r = k;
+      max = fabs(a[k * n + k]);
+      for (i = k + 1; i < n; i++) {
+        if (fabs(a[i * n + k]) > max) {
+          max = fabs(a[i * n + k]);
+          r = i;
+        }
+      }
+      if (max <= EPS) {
+        info = k + 1;
+        break;
+      }
+      if (r != k) {
+        x = &a[k * n];
+        y = &a[r * n];
+        for (j = 0; j < n; j++) {
+          tmp = x[j];
+          x[j] = y[j];
+          y[j] = tmp;
+        }
+        itmp = pi[k];
+        pi[k] = pi[r];
+        pi[r] = itmp;
+      }
+      x = &a[k * n];
+      for (i = k + 1; i < n; i++) {
+        y = &a[i * n];
+        y[k] /= x[k];
+        for (j = k + 1; j < k0 + kb; j++)
+          y[j] -= y[k] * x[j];
+      }
+    }
+    if (info > 0)
+      break;
+
+    /* Compute U12 = inv(L11)*A12 */
+    for (k = k0 + 1; k < k0 + kb; k++) {
+      for (i = k0; i < k; i++) {
+        for (j = k0 + kb; j < n; j++)
+          a[k * n + j] -= a[k * n + i] * a[i * n + j];
+      }
+    }
+
+    /* Update A22 -= L21*U12 */
+    for (i = k0 + kb; i < n; i++) {
+      L[i - k0 - kb] = &a[i * n + k0];
+      C[i - k0 - kb] = &a[i * n];
+    }
+    for (k = 0; k < kb; k++)
+      U[k] = &a[(k0 + k) * n + k0 + kb];
+    mm_sub(n - k0 - kb, n - k0 - kb, kb, L, U, C, k0 + kb);
+  }
+
+  free(C);
+  free(U);
+  free(L);
+
+  return info;
+
+} /* end lu_seq */
+
+void lu_vec(int n, double *w, int *pi, int *info) {
+  /* This sequential function computes the LU decompositions with
+     partial pivoting of VB matrices of size n by n at the same time.
+     The matrices are stored interleaved in w: element (i,j) of
+     matrix v is w[(i*n+j)*VB+v]. The permutations are stored in
+     the same way, pi(i) of matrix v in pi[i*VB+v].
+     All operations are performed for the VB matrices in the innermost
+     loop, which the compiler can vectorise; the pivot search and the
+     row swaps, whose pivot rows may differ between the matrices,
+     are written without branches for this purpose.
+     info[v] is set as by lu_seq. When a pivot of matrix v is at
+     most EPS, its pivot row is kept and its multipliers are set
+     to zero, so that matrix v is no longer changed, while the
+     other matrices are decomposed further. */
+
+  double max[VB], d[VB], l[VB], tmp, *x, *y;
+  int k, i, j, v, r[VB], itmp;
+
+  for (v = 0; v < VB; v++)
+    info[v] = 0;
+
+  for (i = 0; i < n; i++) {
+    for (v = 0; v < VB; v++)
+      pi[i * VB + v] = i;
+  }
+
+  for (k = 0; k < n; k++) {
+    /* Search for the pivots in column k */
+    x = &w[(k * n + k) * VB];
+    for (v = 0; v < VB; v++) {
+      r[v] = k;
+      max[v] = fabs(x[v]);
+    }
+    for (i = k + 1; i < n; i++) {
+      y = &w[(i * n + k) * VB];
+      for (v = 0; v < VB; v++) {
+        r[v] = (fabs(y[v]) > max[v] ? i : r[v]);
+        max[v] = (fabs(y[v]) > max[v] ? fabs(y[v]) : max[v]);
+      }
+    }
+    for (v = 0; v < VB; v++) {
+      if (info[v] == 0 && max[v] <= EPS)
+        info[v] = k + 1;
+      if (info[v] > 0)
+        r[v] = k;
+    }
+
+    /* Swap rows k and r[v] of matrix v; nothing moves if r[v] = k */
+    for (j = 0; j < n; j++) {
+      x = &w[(k * n + j) * VB];
+      for (v = 0; v < VB; v++) {
+        tmp = x[v];
+        x[v] = w[(r[v] * n + j) * VB + v];
+        w[(r[v] * n + j) * VB + v] = tmp;
+      }
+    }
+    for (v = 0; v < VB; v++) {
+      itmp = pi[k * VB + v];
+      pi[k * VB + v] = pi[r[v] * VB + v];
+      pi[r[v] * VB + v] = itmp;
+    }
+
+    /* Compute column k of L and update the rest of the matrices */
+    for (v = 0; v < VB; v++)
+      d[v] = (info[v] > 0 ? 0.0 : 1.0 / w[(k * n + k) * VB + v]);
+    for (i = k + 1; i < n; i++) {
+      y = &w[(i * n + k) * VB];
+      for (v = 0; v < VB; v++) {
+        l[v] = y[v] * d[v];
+        y[v] = (info[v] > 0 ? y[v] : l[v]);
+      }
+      for (j = k + 1; j < n; j++) {
+        x = &w[(k * n + j) * VB];
+        y = &w[(i * n + j) * VB];
+        for (v = 0; v < VB; v++)
+          y[v] -= l[v] * x[v];
+      }
+    }
+  }
+
+} /* end lu_vec */
+
+void mpilu_balance(int nmat, int *n, int p, int *proc) {
+  /* Assign the nmat matrices of sizes n[m] to the p processors,
+     with proc[m] the processor of matrix m, such that the work of
+     the processors, proportional to the sum of n[m]^3, is balanced.
+     The matrices are assigned in order of decreasing size, each to
+     the processor with the least work so far (the LPT rule), which
+     gives a maximum work within 4/3 of the optimum. */
+
+  double *work, wmin;
+  int *order, m, m1, q, qmin, tmp;
+
+  order = vecalloci(nmat);
+  work = vecallocd(p);
+
+  /* Sort the matrices by decreasing size, by insertion */
+  for (m = 0; m < nmat; m++) {
+    tmp = m;
+    for (m1 = m; m1 > 0 && n[order[m1 - 1]] < n[tmp]; m1--)
+      order[m1] = order[m1 - 1];
+    order[m1] = tmp;
+  }
+
+  for (q = 0; q < p; q++)
+    work[q] = 0.0;
+  for (m = 0; m < nmat; m++) {
+    qmin = 0;
+    wmin = work[0];
+    for (q = 1; q < p; q++) {
+      if (work[q] < wmin) {
+        wmin = work[q];
+        qmin = q;
+      }
+    }
+    proc[order[m]] = qmin;
+    work[qmin] += (double)n[order[m]] * n[order[m]] * n[order[m]];
+  }
+
+  vecfreed(work);
+  vecfreei(order);
+
+} /* end mpilu_balance */
+
+void mpilu_batch(int nmat, int *n, int *proc, double **a, int **pi,
+                 int *info, MPI_Comm comm) {
+  /* Compute the LU decompositions with partial pivoting of nmat
+     independent matrices, A_m of size n[m] by n[m], 0 <= m < nmat,
+     such that A_m(pi_m(i),j) = (L_m U_m)(i,j).
+     nmat, n and proc must be given on all processors of comm.
+
+     Matrix m lives on processor proc[m] of comm, for instance as
+     assigned by mpilu_balance. On input, that processor holds A_m
+     by rows in a[m], of n[m]^2 words, and on output L_m\U_m in the
+     same place, and pi_m in pi[m], of n[m] words. For the matrices
+     of other processors, a[m] and pi[m] are not referenced.
+     The matrices are never moved, so that there is no limit
+     on the total size of the batch.
+     On output, info[m] is known on all processors: it is 0 if A_m
+     was decomposed, and k+1 if the pivot of column k of A_m was
+     at most EPS in absolute value, in which case L_m\U_m and pi_m
+     are not a valid decomposition.
+
+     Every processor factors its matrices sequentially, each by one
+     thread. Matrices with n <= VTINY are factored VB at a time by
+     lu_vec, which vectorises over the matrices; the others, and
+     the tiny matrices left over, are factored by lu_seq.
+  */
+
+  int lu_seq(int n, double *a, int *pi);
+  void lu_vec(int n, double *w, int *pi, int *info);
+  int s, m, m1, m2, i, v, nm, nl, nitem, *mine, *grp, *item, *linfo, *vpi,
+      mv[VB], vinfo[VB];
+  double *wv;
+
+  MPI_Comm_rank(comm, &s);
+
+  /****** Superstep 0. Factor my matrices ******/
+  nl = 0;
+  for (m = 0; m < nmat; m++) {
+    if (proc[m] == s)
+      nl++;
+  }
+  mine = vecalloci(nl);
+  nl = 0;
+  for (m = 0; m < nmat; m++) {
+    if (proc[m] == s)
+      mine[nl++] = m;
+  }
+
+  /* Form groups of VB tiny matrices of the same size. Every group
+     and every other matrix is an item of work: item[q] is the first
+     matrix of the q'th item, and grp[m1] is the next matrix of the
+     group of my m1'th matrix, or -1 */
+  grp = vecalloci(nl);
+  item = vecalloci(nl);
+  for (m1 = 0; m1 < nl; m1++)
+    grp[m1] = -2; /* not yet in an item */
+  nitem = 0;
+  for (m1 = 0; m1 < nl; m1++) {
+    if (grp[m1] != -2)
+      continue;
+    item[nitem++] = m1;
+    grp[m1] = -1;
+    if (n[mine[m1]] > VTINY)
+      continue;
+    nm = 1;
+    for (m2 = m1 + 1; m2 < nl && nm < VB; m2++) {
+      if (grp[m2] == -2 && n[mine[m2]] == n[mine[m1]])
+        nm++;
+    }
+    if (nm == VB) {
+      i = m1;
+      for (m2 = m1 + 1; m2 < nl && nm > 1; m2++) {
+        if (grp[m2] == -2 && n[mine[m2]] == n[mine[m1]]) {
+          grp[i] = m2;
+          grp[m2] = -1;
+          i = m2;
+          nm--;
+        }
+      }
+    }
+  }
+
+  linfo = vecalloci(nmat);
+  for (m = 0; m < nmat; m++)
+    linfo[m] = 0;
+
+#pragma omp parallel for private(m1, m2, v, nm, i, wv, vpi, mv, vinfo) \
+    schedule(dynamic)
+  for (m = 0; m < nitem; m++) {
+    m1 = item[m];
+    nm = n[mine[m1]];
+    if (nm > VTINY || grp[m1] < 0) {
+      linfo[mine[m1]] = lu_seq(nm, a[mine[m1]], pi[mine[m1]]);
+    } else {
+      /* Interleave the VB matrices of the group, factor, and split */
+      wv = vecallocd(nm * nm * VB);
+      vpi = vecalloci(nm * VB);
+      for (v = 0, m2 = m1; v < VB; v++, m2 = grp[m2])
+        mv[v] = mine[m2];
+      for (v = 0; v < VB; v++) {
+        for (i = 0; i < nm * nm; i++)
+          wv[i * VB + v] = a[mv[v]][i];
+      }
+      lu_vec(nm, wv, vpi, vinfo);
+      for (v = 0; v < VB; v++) {
+        for (i = 0; i < nm * nm; i++)
+          a[mv[v]][i] = wv[i * VB + v];
+        for (i = 0; i < nm; i++)
+          pi[mv[v]][i] = vpi[i * VB + v];
+        linfo[mv[v]] = vinfo[v];
+      }
+      vecfreei(vpi);
+      vecfreed(wv);
+    }
+  }
+
+  /****** Superstep 1. Tell every processor which matrices failed ******/
+  MPI_Allreduce(linfo, info, nmat, MPI_INT, MPI_MAX, comm);
+
+  vecfreei(linfo);
+  vecfreei(item);
+  vecfreei(grp);
+  vecfreei(mine);
+
+} /* end mpilu_batch */
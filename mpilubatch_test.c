@@ -0,0 +1,176 @@
+#include "mpiedupack.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/*  This is a test program which uses mpilu_batch to decompose nmat
+    independent matrices with sizes between nmin and nmax, chosen
+    pseudo-randomly. The matrices are assigned to the processors
+    by mpilu_balance, and every processor generates its own matrices,
+    pseudo-random matrices with elements in [-1,1]. The last column
+    of A_m is zero if m mod 10 = 9, so that these matrices are
+    singular and mpilu_batch must return info[m] = n[m] for them.
+
+    The time and computing rate of mpilu_batch are printed, together
+    with the load imbalance of the assignment of the matrices,
+    i.e. the ratio of the maximum and the average work of a processor.
+    Afterwards, the number of singular matrices, the number of wrong
+    info values, and the maximum relative residual
+        max |A_m(pi_m(i),j) - (L_m U_m)(i,j)| / max |A_m(i,j)|
+    over all nonsingular matrices are printed.
+*/
+
+double batchmat(int m, int nm, int i, int j) {
+  /* Return the element A_m(i,j) of the test matrix A_m of size nm */
+  unsigned int x;
+
+  x = (unsigned int)i * 2654435761u ^ ((unsigned int)j * 40503u + 7u) ^
+      ((unsigned int)m * 97531u);
+  x ^= x >> 13;
+  x *= 0x5bd1e995u;
+  x ^= x >> 15;
+  if (m % 10 == 9 && j == nm - 1)
+    return 0.0;
+  return (x % 10000) / 5000.0 - 1.0;
+
+} /* end batchmat */
+
+int main(int argc, char **argv) {
+
+  double batchmat(int m, int nm, int i, int j);
+  void mpilu_balance(int nmat, int *n, int p, int *proc);
+  void mpilu_batch(int nmat, int *n, int *proc, double **a, int **pi,
+                   int *info, MPI_Comm comm);
+  int p, pid, provided, nmat, nmin, nmax, m, i, j, k, q, nsing, nbad, *n,
+      *proc, *info, **pi;
+  double **a, *work, time0, time1, flops, maxwork, sumwork, lu, amax, res,
+      maxres;
+
+  /* Only the master thread of each processor communicates */
+  MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+#ifdef _OPENMP
+  if (provided < MPI_THREAD_FUNNELED)
+    omp_set_num_threads(1);
+#endif
+
+  MPI_Comm_size(MPI_COMM_WORLD, &p);
+  MPI_Comm_rank(MPI_COMM_WORLD, &pid);
+
+  if (pid == 0) {
+    printf("Please enter number of matrices nmat:\n");
+    scanf("%d", &nmat);
+    if (nmat < 1)
+      MPI_Abort(MPI_COMM_WORLD, -12);
+    printf("Please enter minimum and maximum matrix size nmin nmax:\n");
+    scanf("%d %d", &nmin, &nmax);
+    if (nmin < 1 || nmax < nmin)
+      MPI_Abort(MPI_COMM_WORLD, -12);
+  }
+  MPI_Bcast(&nmat, 1, MPI_INT, 0, MPI_COMM_WORLD);
+  MPI_Bcast(&nmin, 1, MPI_INT, 0, MPI_COMM_WORLD);
+  MPI_Bcast(&nmax, 1, MPI_INT, 0, MPI_COMM_WORLD);
+
+  n = vecalloci(nmat);
+  flops = 0.0;
+  for (m = 0; m < nmat; m++) {
+    n[m] = nmin + (int)(((unsigned int)m * 2654435761u >> 8) %
+                        (unsigned int)(nmax - nmin + 1));
+    flops += 2.0 * n[m] * n[m] * n[m] / 3.0;
+  }
+  proc = vecalloci(nmat);
+  mpilu_balance(nmat, n, p, proc);
+
+  /* Every processor generates its own matrices */
+  a = (double **)malloc(nmat * sizeof(double *));
+  pi = (int **)malloc(nmat * sizeof(int *));
+  if (a == NULL || pi == NULL)
+    MPI_Abort(MPI_COMM_WORLD, -13);
+  for (m = 0; m < nmat; m++) {
+    a[m] = NULL;
+    pi[m] = NULL;
+    if (proc[m] != pid)
+      continue;
+    a[m] = vecallocd(n[m] * n[m]);
+    pi[m] = vecalloci(n[m]);
+    for (i = 0; i < n[m]; i++) {
+      for (j = 0; j < n[m]; j++)
+        a[m][i * n[m] + j] = batchmat(m, n[m], i, j);
+    }
+  }
+  info = vecalloci(nmat);
+
+  if (pid == 0) {
+    /* Load imbalance of the assignment */
+    work = vecallocd(p);
+    for (q = 0; q < p; q++)
+      work[q] = 0.0;
+    for (m = 0; m < nmat; m++)
+      work[proc[m]] += (double)n[m] * n[m] * n[m];
+    maxwork = sumwork = 0.0;
+    for (q = 0; q < p; q++) {
+      maxwork = MAX(maxwork, work[q]);
+      sumwork += work[q];
+    }
+    vecfreed(work);
+
+    printf("LU decomposition of %d matrices with n in [%d,%d]\n", nmat, nmin,
+           nmax);
+    printf("Load imbalance = %.3lf\n", maxwork * p / sumwork);
+  }
+
+  MPI_Barrier(MPI_COMM_WORLD);
+  time0 = MPI_Wtime();
+  mpilu_batch(nmat, n, proc, a, pi, info, MPI_COMM_WORLD);
+  MPI_Barrier(MPI_COMM_WORLD);
+  time1 = MPI_Wtime();
+
+  /* Check info and A_m(pi_m(i),j) = (L_m U_m)(i,j) for my matrices */
+  maxres = 0.0;
+  nsing = nbad = 0;
+  for (m = 0; m < nmat; m++) {
+    if (info[m] > 0)
+      nsing++;
+    if (info[m] != (m % 10 == 9 ? n[m] : 0))
+      nbad++;
+    if (proc[m] != pid || info[m] > 0)
+      continue;
+    amax = res = 0.0;
+    for (i = 0; i < n[m]; i++) {
+      for (j = 0; j < n[m]; j++) {
+        lu = (i <= j ? a[m][i * n[m] + j] : 0.0);
+        for (k = 0; k < MIN(i, j + 1); k++)
+          lu += a[m][i * n[m] + k] * a[m][k * n[m] + j];
+        amax = MAX(amax, fabs(batchmat(m, n[m], i, j)));
+        res = MAX(res, fabs(batchmat(m, n[m], pi[m][i], j) - lu));
+      }
+    }
+    maxres = MAX(maxres, res / amax);
+  }
+  MPI_Allreduce(MPI_IN_PLACE, &maxres, 1, MPI_DOUBLE, MPI_MAX,
+                MPI_COMM_WORLD);
+
+  if (pid == 0) {
+    printf("This took only %.6lf seconds.\n", time1 - time0);
+    printf("Computing rate = %.3lf Gflop/s\n",
+           flops / ((time1 - time0) * 1.0e9));
+    printf("Singular matrices = %d, wrong info = %d\n", nsing, nbad);
+    printf("Maximum relative residual = %e\n", maxres);
+  }
+
+  for (m = 0; m < nmat; m++) {
+    if (proc[m] == pid) {
+      vecfreei(pi[m]);
+      vecfreed(a[m]);
+    }
+  }
+  vecfreei(info);
+  free(pi);
+  free(a);
+  vecfreei(proc);
+  vecfreei(n);
+
+  MPI_Finalize();
+
+  exit(0);
+
+} /* end main */
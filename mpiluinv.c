@@ -0,0 +1,571 @@
+#include "mpiedupack.h"
+#include "mpigrid.h"
+
+void mpilu_getpi(struct mpigrid *grid, int n, int b, int *pi, int *piall,
+                 int all) {
+  /* Gather the permutation pi of mpilu, which is stored in the
+     processors P(*,0) for their local rows, into the global vector
+     piall of length n. If all is TRUE, piall is obtained on all
+     processors of grid, by gathering pi within processor column 0
+     and broadcasting it within every processor row; otherwise,
+     it is only gathered on P(0,0), and piall is only used there.
+     All processors of grid must call this function. */
+
+  int nloc(int p, int s, int n, int b);
+  int gindex(int p, int s, int i, int b);
+  int M, s, q, i, *buf, *cnt, *displ;
+
+  M = grid->M;
+  s = grid->s;
+
+  if (grid->t == 0) {
+    buf = vecalloci(all || s == 0 ? n : 0);
+    cnt = vecalloci(M);
+    displ = vecalloci(M);
+    for (q = 0; q < M; q++)
+      cnt[q] = nloc(M, q, n, b);
+    displ[0] = 0;
+    for (q = 1; q < M; q++)
+      displ[q] = displ[q - 1] + cnt[q - 1];
+    if (all)
+      MPI_Allgatherv(pi, cnt[s], MPI_INT, buf, cnt, displ, MPI_INT,
+                     grid->col_comm);
+    else
+      MPI_Gatherv(pi, cnt[s], MPI_INT, buf, cnt, displ, MPI_INT, 0,
+                  grid->col_comm);
+    if (all || s == 0) {
+      for (q = 0; q < M; q++) {
+        for (i = 0; i < cnt[q]; i++)
+          piall[gindex(M, q, i, b)] = buf[displ[q] + i];
+      }
+    }
+    vecfreei(displ);
+    vecfreei(cnt);
+    vecfreei(buf);
+  }
+  if (all)
+    MPI_Bcast(piall, n, MPI_INT, 0, grid->row_comm);
+
+} /* end mpilu_getpi */
+
+void mpilu_getdiag(struct mpigrid *grid, int b, int k0, int kb, int nb,
+                   double **a, double **D) {
+  /* Gather the kb by kb diagonal block A(k,j), k0 <= k,j < k0+kb,
+     into D(k-k0,j-k0) on all processors of grid. D must have been
+     allocated by matallocd as an nb by nb matrix, with kb <= nb.
+     The whole matrix D is summed, so that this takes one reduction. */
+
+  int nloc(int p, int s, int n, int b);
+  int gindex(int p, int s, int i, int b);
+  int M, N, s, t, kr0, kre, kc0, kce, i, j;
+
+  M = grid->M;
+  N = grid->N;
+  s = grid->s;
+  t = grid->t;
+
+  kr0 = nloc(M, s, k0, b);
+  kre = nloc(M, s, k0 + kb, b);
+  kc0 = nloc(N, t, k0, b);
+  kce = nloc(N, t, k0 + kb, b);
+
+  for (i = 0; i < nb * nb; i++)
+    D[0][i] = 0.0;
+  for (i = kr0; i < kre; i++) {
+    for (j = kc0; j < kce; j++)
+      D[gindex(M, s, i, b) - k0][gindex(N, t, j, b) - k0] = a[i][j];
+  }
+  MPI_Allreduce(MPI_IN_PLACE, D[0], nb * nb, MPI_DOUBLE, MPI_SUM,
+                grid->comm);
+
+} /* end mpilu_getdiag */
+
+void mpilu_getcols(int N, int t, int b, int nr, int k0, int kb, double **a,
+                   double **C, double *buf, double *buf1, int *cnt,
+                   int *displ, MPI_Comm row_comm_s) {
+  /* Gather the local rows i < nr of the kb columns k0 <= k < k0+kb
+     of A within processor row s, and store them in C(i,k-k0),
+     as mpilu_getpanel does for the local rows below the panel.
+     buf and buf1 must have room for nr*kb elements, cnt and displ
+     for N integers. */
+
+  int nloc(int p, int s, int n, int b);
+  int gindex(int p, int s, int i, int b);
+  int kc0, kce, i, j, jj, q;
+
+  kc0 = nloc(N, t, k0, b);
+  kce = nloc(N, t, k0 + kb, b);
+
+  for (j = kc0; j < kce; j++) {
+    for (i = 0; i < nr; i++)
+      buf[(j - kc0) * nr + i] = a[i][j];
+  }
+  for (q = 0; q < N; q++)
+    cnt[q] = (nloc(N, q, k0 + kb, b) - nloc(N, q, k0, b)) * nr;
+  displ[0] = 0;
+  for (q = 1; q < N; q++)
+    displ[q] = displ[q - 1] + cnt[q - 1];
+  MPI_Allgatherv(buf, cnt[t], MPI_DOUBLE, buf1, cnt, displ, MPI_DOUBLE,
+                 row_comm_s);
+  for (q = 0; q < N; q++) {
+    for (jj = 0; jj < nloc(N, q, k0 + kb, b) - nloc(N, q, k0, b); jj++) {
+      j = gindex(N, q, nloc(N, q, k0, b) + jj, b);
+      for (i = 0; i < nr; i++)
+        C[i][j - k0] = buf1[displ[q] + jj * nr + i];
+    }
+  }
+
+} /* end mpilu_getcols */
+
+void mpilu_logdet(struct mpigrid *grid, int n, int b, int *pi, double **a,
+                  double *logabs, int *sign) {
+  /* Compute the determinant of the n by n matrix A from its
+     LU decomposition A(pi(i),j) = (LU)(i,j) computed by mpilu or
+     mpilu_blocked, as det(A) = sign * exp(logabs), where logabs is
+     the logarithm of |det(A)| and sign is -1, 0 or 1. Since L has
+     a unit diagonal, det(A) is the product of the diagonal of U,
+     times the sign of the permutation pi. The logarithm avoids the
+     overflow and underflow of the product for large n.
+     Every processor sums the logarithms and counts the negative
+     and zero elements of its part of the diagonal, and processor
+     P(0,0) adds the parity of pi, which follows from the number of
+     cycles of pi, after gathering pi within processor column 0.
+     One reduction then gives the result on all processors of grid. */
+
+  void mpilu_getpi(struct mpigrid *grid, int n, int b, int *pi, int *piall,
+                   int all);
+  int nloc(int p, int s, int n, int b);
+  int owner(int p, int k, int b);
+  int lindex(int p, int k, int b);
+  int gindex(int p, int s, int i, int b);
+  int M, N, s, t, nlr, i, gi, k, ncycles, *piall;
+  double u, sum[3], sum_glob[3];
+
+  M = grid->M;
+  N = grid->N;
+  s = grid->s;
+  t = grid->t;
+  nlr = nloc(M, s, n, b);
+
+  piall = vecalloci(s == 0 && t == 0 ? n : 0);
+  mpilu_getpi(grid, n, b, pi, piall, FALSE);
+
+  /* sum[0] = sum of log|u_kk|, sum[1] = number of sign changes,
+     sum[2] = number of zeros */
+  sum[0] = sum[1] = sum[2] = 0.0;
+  for (i = 0; i < nlr; i++) {
+    gi = gindex(M, s, i, b);
+    if (owner(N, gi, b) == t) {
+      u = a[i][lindex(N, gi, b)];
+      if (u == 0.0) {
+        sum[2] += 1.0;
+      } else {
+        sum[0] += log(fabs(u));
+        if (u < 0.0)
+          sum[1] += 1.0;
+      }
+    }
+  }
+
+  if (s == 0 && t == 0) {
+    /* The parity of pi is the parity of n - number of cycles.
+       The cycles are followed by marking the visited elements
+       in piall with -1. */
+    ncycles = 0;
+    for (i = 0; i < n; i++) {
+      if (piall[i] >= 0) {
+        ncycles++;
+        for (k = i; piall[k] >= 0;) {
+          gi = piall[k];
+          piall[k] = -1;
+          k = gi;
+        }
+      }
+    }
+    sum[1] += (n - ncycles) % 2;
+  }
+  MPI_Allreduce(sum, sum_glob, 3, MPI_DOUBLE, MPI_SUM, grid->comm);
+
+  *logabs = sum_glob[0];
+  if (sum_glob[2] > 0.0) {
+    *logabs = -HUGE_VAL;
+    *sign = 0;
+  } else {
+    *sign = ((long)sum_glob[1] % 2 == 0 ? 1 : -1);
+  }
+
+  vecfreei(piall);
+
+} /* end mpilu_logdet */
+
+double mpilu_det(struct mpigrid *grid, int n, int b, int *pi, double **a) {
+  /* Return det(A) from the LU decomposition of A, see mpilu_logdet.
+     The result overflows to +-HUGE_VAL or underflows to zero
+     if |det(A)| is outside the range of doubles. */
+
+  void mpilu_logdet(struct mpigrid *grid, int n, int b, int *pi, double **a,
+                    double *logabs, int *sign);
+  double logabs;
+  int sign;
+
+  mpilu_logdet(grid, n, b, pi, a, &logabs, &sign);
+
+  return (sign == 0 ? 0.0 : sign * exp(logabs));
+
+} /* end mpilu_det */
+
+void mpilu_inverse(struct mpigrid *grid, int n, int b, int nb, int *pi,
+                   double **a) {
+  /* Compute the inverse of the n by n matrix A from its LU decomposition
+     A(pi(i),j) = (LU)(i,j) computed by mpilu or mpilu_blocked,
+     with L\U stored in a and pi in the processors P(*,0).
+     On output, a contains the inverse of A, in the same M by N
+     block-cyclic distribution with b by b blocks.
+     Program text for P(s,t).
+
+     The inverse is A^-1 = U^-1 L^-1 P, computed in place in three
+     phases, each in panels of nb columns, independently of b:
+     1. U is replaced by U^-1, by Gauss-Jordan elimination restricted
+        to the upper triangle. Stage J inverts the diagonal block U_JJ,
+        scales the row panel U_J* to the right of it by U_JJ^-1 and
+        the column panel U_*J above it by -U_JJ^-1, and updates the
+        block above and to the right of the diagonal block by a
+        rank-kb update with mm_sub, as in mpilu_blocked.
+     2. X = U^-1 L^-1 is obtained by solving X L = U^-1 from the right,
+        as in LAPACK getri: the panel X_*J is the upper part of the
+        panel of U^-1 minus X_*K L_KJ, where K are the columns to the
+        right of the panel, multiplied by L_JJ^-1. The rows of L_KJ
+        are needed by the processors that own columns K, so they
+        are first gathered within processor rows and then within
+        processor columns. The partial products are summed within
+        each processor row.
+     3. Column pi(j) of A^-1 is column j of X, so the columns are
+        permuted, as a sequence of column swaps that is applied in
+        batches of nb swaps, each by one MPI_Alltoallv in every
+        processor row.
+     This takes about 2n^3/p flops and the diagonal blocks are
+     obtained by one reduction of nb^2 words per panel. Besides a,
+     the memory is O(max(nlr,nlc)*nb) words and O(n) integers.
+  */
+
+  int nloc(int p, int s, int n, int b);
+  int owner(int p, int k, int b);
+  int lindex(int p, int k, int b);
+  int gindex(int p, int s, int i, int b);
+  void mm_sub(int m, int n, int kb, double **l, double **u, double **c,
+              int jc);
+  void mpilu_getpanel(int M, int N, int s, int t, int b, int nlr, int k0,
+                      int kb, double **a, double **P, double *buf,
+                      double *buf1, int *cnt, int *displ, int root,
+                      MPI_Comm row_comm_s);
+  void mpilu_getu(int M, int s, int b, int k0, int kb, int c0, int c1,
+                  double **a, double **U, double *buf, double *buf1,
+                  int *cnt, int *displ, MPI_Comm col_comm_t);
+  void mpilu_getpi(struct mpigrid *grid, int n, int b, int *pi, int *piall,
+                   int all);
+  void mpilu_getdiag(struct mpigrid *grid, int b, int k0, int kb, int nb,
+                     double **a, double **D);
+  void mpilu_getcols(int N, int t, int b, int nr, int k0, int kb, double **a,
+                     double **C, double *buf, double *buf1, int *cnt,
+                     int *displ, MPI_Comm row_comm_s);
+  double **P, **U, **D, **Z, **W, **X, *buf, *buf1, *row, sum;
+  int M, N, s, t, nlr, nlc, k0, kb, i, j, k, c, gi, gj, q, e, len, kr0, kre,
+      kc0, kce, *cnt, *displ, *scnt, *sdispl, *rcnt, *rdispl, *piall, *cur,
+      *where, *sw, *posv, *lab;
+
+  MPI_Comm row_comm_s, col_comm_t;
+
+  M = grid->M;
+  N = grid->N;
+  s = grid->s;
+  t = grid->t;
+  row_comm_s = grid->row_comm;
+  col_comm_t = grid->col_comm;
+
+  nlr = nloc(M, s, n, b); /* number of local rows */
+  nlc = nloc(N, t, n, b); /* number of local columns */
+
+  P = matallocd(nlr, nb);
+  Z = matallocd(nlr, nb);
+  U = matallocd(nb, nlc);
+  W = matallocd(nlc, nb);
+  D = matallocd(nb, nb);
+  X = (double **)malloc(MAX(nlr, 1) * sizeof(double *));
+  if (X == NULL)
+    MPI_Abort(MPI_COMM_WORLD, -13);
+  row = vecallocd(nb);
+  buf = vecallocd(2 * MAX(nlr, nlc) * nb);
+  buf1 = vecallocd(2 * MAX(nlr, nlc) * nb);
+  cnt = vecalloci(MAX(M, N));
+  displ = vecalloci(MAX(M, N));
+
+  /****** Phase 1. Replace U by U^-1 ******/
+  for (k0 = 0; k0 < n; k0 += nb) {
+    kb = MIN(nb, n - k0);
+    kr0 = nloc(M, s, k0, b);
+    kre = nloc(M, s, k0 + kb, b);
+    kc0 = nloc(N, t, k0, b);
+    kce = nloc(N, t, k0 + kb, b);
+
+    /* Superstep 0. Gather the diagonal block and the panels */
+    mpilu_getdiag(grid, b, k0, kb, nb, a, D);
+    mpilu_getcols(N, t, b, kr0, k0, kb, a, P, buf, buf1, cnt, displ,
+                  row_comm_s);
+    mpilu_getu(M, s, b, k0, kb, kce, nlc, a, U, buf, buf1, cnt, displ,
+               col_comm_t);
+
+    /* Superstep 1. Invert U_JJ redundantly, column by column,
+       using the columns of U_JJ^-1 that are already done */
+    for (j = 0; j < kb; j++) {
+      if (D[j][j] == 0.0)
+        MPI_Abort(MPI_COMM_WORLD, -6);
+      D[j][j] = 1.0 / D[j][j];
+      for (i = 0; i < j; i++) {
+        sum = 0.0;
+        for (k = i; k < j; k++)
+          sum += D[i][k] * D[k][j];
+        row[i] = -sum * D[j][j];
+      }
+      for (i = 0; i < j; i++)
+        D[i][j] = row[i];
+    }
+
+    /* P := P * U_JJ^-1 for the rows above the panel */
+    for (i = 0; i < kr0; i++) {
+      for (c = 0; c < kb; c++) {
+        sum = 0.0;
+        for (k = 0; k <= c; k++)
+          sum += P[i][k] * D[k][c];
+        row[c] = sum;
+      }
+      for (c = 0; c < kb; c++)
+        P[i][c] = row[c];
+    }
+
+    /* Update the block above and to the right of U_JJ */
+    mm_sub(kr0, nlc - kce, kb, P, U, a, kce);
+
+    /* Store the new panels and the diagonal block */
+    for (i = 0; i < kr0; i++) {
+      for (j = kc0; j < kce; j++)
+        a[i][j] = -P[i][gindex(N, t, j, b) - k0];
+    }
+    for (i = kr0; i < kre; i++) {
+      k = gindex(M, s, i, b) - k0;
+      for (j = kce; j < nlc; j++) {
+        sum = 0.0;
+        for (c = k; c < kb; c++)
+          sum += D[k][c] * U[c][j - kce];
+        a[i][j] = sum;
+      }
+      for (j = kc0; j < kce; j++) {
+        c = gindex(N, t, j, b) - k0;
+        if (c >= k)
+          a[i][j] = D[k][c];
+      }
+    }
+  }
+
+  /****** Phase 2. Solve X L = U^-1 from the right ******/
+  for (k0 = ((n - 1) / nb) * nb; k0 >= 0; k0 -= nb) {
+    kb = MIN(nb, n - k0);
+    kr0 = nloc(M, s, k0, b);
+    kre = nloc(M, s, k0 + kb, b);
+    kc0 = nloc(N, t, k0, b);
+    kce = nloc(N, t, k0 + kb, b);
+
+    /* Superstep 0. Gather the diagonal block L_JJ and the panel
+       of L within processor row s */
+    mpilu_getdiag(grid, b, k0, kb, nb, a, D);
+    mpilu_getpanel(M, N, s, t, b, nlr, k0, kb, a, P, buf, buf1, cnt, displ,
+                   -1, row_comm_s);
+
+    /* Superstep 1. Gather the rows of L_KJ for my local columns
+       within processor column t. P(s,t) contributes the rows k
+       with s = owner(M,k,b) and t = owner(N,k,b). */
+    len = 0;
+    for (i = kre; i < nlr; i++) {
+      gi = gindex(M, s, i, b);
+      if (owner(N, gi, b) == t) {
+        for (c = 0; c < kb; c++)
+          buf[len++] = P[i][c];
+      }
+    }
+    for (q = 0; q < M; q++) {
+      cnt[q] = 0;
+      for (i = nloc(M, q, k0 + kb, b); i < nloc(M, q, n, b); i++) {
+        if (owner(N, gindex(M, q, i, b), b) == t)
+          cnt[q] += kb;
+      }
+    }
+    displ[0] = 0;
+    for (q = 1; q < M; q++)
+      displ[q] = displ[q - 1] + cnt[q - 1];
+    MPI_Allgatherv(buf, cnt[s], MPI_DOUBLE, buf1, cnt, displ, MPI_DOUBLE,
+                   col_comm_t);
+    for (q = 0; q < M; q++) {
+      e = displ[q];
+      for (i = nloc(M, q, k0 + kb, b); i < nloc(M, q, n, b); i++) {
+        gi = gindex(M, q, i, b);
+        if (owner(N, gi, b) == t) {
+          for (c = 0; c < kb; c++)
+            W[lindex(N, gi, b) - kce][c] = buf1[e++];
+        }
+      }
+    }
+
+    /* Superstep 2. Compute my part of U^-1_*J - X_*K L_KJ
+       and sum the parts within processor row s */
+    for (i = 0; i < nlr * nb; i++)
+      Z[0][i] = 0.0;
+    for (j = kc0; j < kce; j++) {
+      gj = gindex(N, t, j, b);
+      for (i = 0; i < nlr; i++) {
+        if (gindex(M, s, i, b) <= gj)
+          Z[i][gj - k0] = a[i][j];
+      }
+    }
+    for (i = 0; i < nlr; i++)
+      X[i] = &a[i][kce];
+    mm_sub(nlr, kb, nlc - kce, X, W, Z, 0);
+    MPI_Allreduce(MPI_IN_PLACE, (nlr > 0 ? Z[0] : buf), nlr * nb, MPI_DOUBLE,
+                  MPI_SUM, row_comm_s);
+
+    /* Superstep 3. Multiply by L_JJ^-1 from the right
+       and store my columns of X_*J */
+    for (i = 0; i < nlr; i++) {
+      for (c = kb - 1; c >= 0; c--) {
+        sum = Z[i][c];
+        for (k = c + 1; k < kb; k++)
+          sum -= Z[i][k] * D[k][c];
+        Z[i][c] = sum;
+      }
+      for (j = kc0; j < kce; j++)
+        a[i][j] = Z[i][gindex(N, t, j, b) - k0];
+    }
+  }
+
+  /****** Phase 3. Move column j of X to column pi(j) ******/
+  /* The permutation is written as a sequence of swaps of columns k
+     and sw[k] >= k, k = 0,1,...,n-1, as in LAPACK, with cur[c] the
+     column of X that is currently at position c and where[j] the
+     current position of column j of X. Every processor computes the
+     whole sequence, which takes O(n) time and memory. */
+  piall = vecalloci(n);
+  mpilu_getpi(grid, n, b, pi, piall, TRUE);
+  cur = vecalloci(n);
+  where = vecalloci(n);
+  sw = vecalloci(n);
+  for (c = 0; c < n; c++) {
+    cur[c] = where[c] = c;
+    sw[piall[c]] = c; /* sw[k] first holds the column that goes to k */
+  }
+  for (k = 0; k < n; k++) {
+    j = sw[k];
+    c = where[j];
+    sw[k] = c;
+    cur[c] = cur[k];
+    where[cur[c]] = c;
+    cur[k] = j;
+    where[j] = k;
+  }
+
+  /* The swaps are applied in batches of nb: the at most 2nb positions
+     of a batch are collected in posv, and lab[e] is the position
+     whose column moves to position posv[e]. Every batch takes one
+     MPI_Alltoallv within the processor row, which sends every column
+     in increasing order of e, so that it needs no index. */
+  posv = vecalloci(2 * nb);
+  lab = vecalloci(2 * nb);
+  scnt = vecalloci(N);
+  sdispl = vecalloci(N);
+  rcnt = vecalloci(N);
+  rdispl = vecalloci(N);
+
+  for (k0 = 0; k0 < n; k0 += nb) {
+    kb = MIN(nb, n - k0);
+    len = 0;
+    for (k = k0; k < k0 + kb; k++) {
+      for (c = 0; c < 2; c++) {
+        gj = (c == 0 ? k : sw[k]);
+        for (e = 0; e < len && posv[e] != gj; e++)
+          ;
+        if (e == len) {
+          posv[len] = lab[len] = gj;
+          len++;
+        }
+      }
+    }
+    for (k = k0; k < k0 + kb; k++) {
+      for (i = 0; posv[i] != k; i++)
+        ;
+      for (j = 0; posv[j] != sw[k]; j++)
+        ;
+      e = lab[i];
+      lab[i] = lab[j];
+      lab[j] = e;
+    }
+
+    for (q = 0; q < N; q++)
+      scnt[q] = rcnt[q] = 0;
+    for (e = 0; e < len; e++) {
+      if (lab[e] == posv[e])
+        continue;
+      if (owner(N, lab[e], b) == t)
+        scnt[owner(N, posv[e], b)] += nlr;
+      if (owner(N, posv[e], b) == t)
+        rcnt[owner(N, lab[e], b)] += nlr;
+    }
+    sdispl[0] = rdispl[0] = 0;
+    for (q = 1; q < N; q++) {
+      sdispl[q] = sdispl[q - 1] + scnt[q - 1];
+      rdispl[q] = rdispl[q - 1] + rcnt[q - 1];
+    }
+
+    for (q = 0; q < N; q++)
+      cnt[q] = sdispl[q];
+    for (e = 0; e < len; e++) {
+      if (lab[e] != posv[e] && owner(N, lab[e], b) == t) {
+        q = owner(N, posv[e], b);
+        j = lindex(N, lab[e], b);
+        for (i = 0; i < nlr; i++)
+          buf[cnt[q]++] = a[i][j];
+      }
+    }
+    MPI_Alltoallv(buf, scnt, sdispl, MPI_DOUBLE, buf1, rcnt, rdispl,
+                  MPI_DOUBLE, row_comm_s);
+    for (q = 0; q < N; q++)
+      cnt[q] = rdispl[q];
+    for (e = 0; e < len; e++) {
+      if (lab[e] != posv[e] && owner(N, posv[e], b) == t) {
+        q = owner(N, lab[e], b);
+        j = lindex(N, posv[e], b);
+        for (i = 0; i < nlr; i++)
+          a[i][j] = buf1[cnt[q]++];
+      }
+    }
+  }
+
+  vecfreei(rdispl);
+  vecfreei(rcnt);
+  vecfreei(sdispl);
+  vecfreei(scnt);
+  vecfreei(lab);
+  vecfreei(posv);
+  vecfreei(sw);
+  vecfreei(where);
+  vecfreei(cur);
+  vecfreei(piall);
+  vecfreei(displ);
+  vecfreei(cnt);
+  vecfreed(buf1);
+  vecfreed(buf);
+  vecfreed(row);
+  free(X);
+  matfreed(D);
+  matfreed(W);
+  matfreed(U);
+  matfreed(Z);
+  matfreed(P);
+
+} /* end mpilu_inverse */
@@ -0,0 +1,194 @@
+#include "mpiedupack.h"
+#include "mpigrid.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/*  This is a test program which uses mpilu_blocked to decompose
+    an n by n matrix A, distributed over an M by N processor grid with
+    b by b blocks, and then uses the factors to compute the determinant
+    of A by mpilu_logdet and the inverse of A by mpilu_inverse.
+    A is a pseudo-random matrix with elements in [-1,1], computed from
+    the global indices.
+
+    For n <= CHECKDET, the determinant is also computed by processor 0
+    by sequential Gaussian elimination, and both values are printed.
+    The inverse is checked by computing A*A^-1 - I by mpimm
+    and printing its maximum absolute element.
+*/
+
+#define CHECKDET 500
+
+double invmat(int i, int j) {
+  /* Return the element (i,j) of the test matrix A */
+  unsigned int x;
+
+  x = (unsigned int)i * 2654435761u ^ ((unsigned int)j * 40503u + 7u);
+  x ^= x >> 13;
+  x *= 0x5bd1e995u;
+  x ^= x >> 15;
+  return (x % 10000) / 5000.0 - 1.0;
+
+} /* end invmat */
+
+int main(int argc, char **argv) {
+
+  struct mpigrid *mpigrid_create(int M, int N, MPI_Comm comm);
+  void mpigrid_free(struct mpigrid *grid);
+  int nloc(int p, int s, int n, int b);
+  int gindex(int p, int s, int i, int b);
+  double invmat(int i, int j);
+  void mpilu_blocked(struct mpigrid *grid, int n, int b, int nb, int batch,
+                     int calu, int *pi, double **a);
+  void mpilu_logdet(struct mpigrid *grid, int n, int b, int *pi, double **a,
+                    double *logabs, int *sign);
+  void mpilu_inverse(struct mpigrid *grid, int n, int b, int nb, int *pi,
+                     double **a);
+  void mpimm(struct mpigrid *grid, int m, int n, int k, int b, int nb,
+             int bcast, double **a, double **bm, double **c);
+  int p, pid, provided, M, N, s, t, n, b, nb, nlr, nlc, i, j, k, r, sign,
+      sign1, *pi;
+  double **a, **a0, **c, **af, time0, time1, time2, logabs, logabs1, max,
+      tmp, error, max_error;
+  struct mpigrid *grid;
+
+  /* Only the master thread of each processor communicates */
+  MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+#ifdef _OPENMP
+  if (provided < MPI_THREAD_FUNNELED)
+    omp_set_num_threads(1);
+#endif
+
+  MPI_Comm_size(MPI_COMM_WORLD, &p);
+  MPI_Comm_rank(MPI_COMM_WORLD, &pid);
+
+  if (pid == 0) {
+    printf("Please enter number of processor rows M:\n");
+    scanf("%d", &M);
+    printf("Please enter number of processor columns N:\n");
+    scanf("%d", &N);
+    if (M * N != p)
+      MPI_Abort(MPI_COMM_WORLD, -5);
+    printf("Please enter matrix size n:\n");
+    scanf("%d", &n);
+    printf("Please enter distribution block size b:\n");
+    scanf("%d", &b);
+    if (b < 1)
+      MPI_Abort(MPI_COMM_WORLD, -12);
+    printf("Please enter panel width nb:\n");
+    scanf("%d", &nb);
+    if (nb < 1)
+      MPI_Abort(MPI_COMM_WORLD, -12);
+  }
+  MPI_Bcast(&M, 1, MPI_INT, 0, MPI_COMM_WORLD);
+  MPI_Bcast(&N, 1, MPI_INT, 0, MPI_COMM_WORLD);
+  MPI_Bcast(&n, 1, MPI_INT, 0, MPI_COMM_WORLD);
+  MPI_Bcast(&b, 1, MPI_INT, 0, MPI_COMM_WORLD);
+  MPI_Bcast(&nb, 1, MPI_INT, 0, MPI_COMM_WORLD);
+
+  grid = mpigrid_create(M, N, MPI_COMM_WORLD);
+  s = grid->s;
+  t = grid->t;
+  nlr = nloc(M, s, n, b);
+  nlc = nloc(N, t, n, b);
+  a = matallocd(nlr, nlc);
+  a0 = matallocd(nlr, nlc);
+  c = matallocd(nlr, nlc);
+  pi = vecalloci(nlr);
+
+  for (i = 0; i < nlr; i++) {
+    for (j = 0; j < nlc; j++)
+      a[i][j] = a0[i][j] = invmat(gindex(M, s, i, b), gindex(N, t, j, b));
+  }
+
+  if (pid == 0)
+    printf("Determinant and inverse of %d by %d matrix on %d by %d grid\n",
+           n, n, M, N);
+
+  MPI_Barrier(MPI_COMM_WORLD);
+  time0 = MPI_Wtime();
+  mpilu_blocked(grid, n, b, nb, TRUE, FALSE, pi, a);
+  mpilu_logdet(grid, n, b, pi, a, &logabs, &sign);
+  MPI_Barrier(MPI_COMM_WORLD);
+  time1 = MPI_Wtime();
+  mpilu_inverse(grid, n, b, nb, pi, a);
+  MPI_Barrier(MPI_COMM_WORLD);
+  time2 = MPI_Wtime();
+
+  if (pid == 0) {
+    printf("log|det(A)| = %.12e, sign = %d\n", logabs, sign);
+    printf("Decomposition and determinant took %.6lf seconds.\n",
+           time1 - time0);
+    printf("Inverse took %.6lf seconds, rate = %.3lf Gflop/s\n",
+           time2 - time1, 2.0 * n * (double)n * n / ((time2 - time1) * 1.0e9));
+
+    if (n <= CHECKDET) {
+      /* Sequential Gaussian elimination with partial pivoting */
+      af = matallocd(n, n);
+      for (i = 0; i < n; i++) {
+        for (j = 0; j < n; j++)
+          af[i][j] = invmat(i, j);
+      }
+      logabs1 = 0.0;
+      sign1 = 1;
+      for (k = 0; k < n; k++) {
+        r = k;
+        max = 0.0;
+        for (i = k; i < n; i++) {
+          if (fabs(af[i][k]) > max) {
+            max = fabs(af[i][k]);
+            r = i;
+          }
+        }
+        if (max == 0.0) {
+          sign1 = 0;
+          break;
+        }
+        if (r != k) {
+          sign1 = -sign1;
+          for (j = 0; j < n; j++) {
+            tmp = af[k][j];
+            af[k][j] = af[r][j];
+            af[r][j] = tmp;
+          }
+        }
+        if (af[k][k] < 0.0)
+          sign1 = -sign1;
+        logabs1 += log(fabs(af[k][k]));
+        for (i = k + 1; i < n; i++) {
+          tmp = af[i][k] / af[k][k];
+          for (j = k + 1; j < n; j++)
+            af[i][j] -= tmp * af[k][j];
+        }
+      }
+      printf("Sequential: log|det(A)| = %.12e, sign = %d\n", logabs1, sign1);
+      matfreed(af);
+    }
+  }
+
+  /* Check A*A^-1 - I */
+  for (i = 0; i < nlr; i++) {
+    for (j = 0; j < nlc; j++)
+      c[i][j] = (gindex(M, s, i, b) == gindex(N, t, j, b) ? -1.0 : 0.0);
+  }
+  mpimm(grid, n, n, n, b, nb, BCAST_MPI, a0, a, c);
+  error = 0.0;
+  for (i = 0; i < nlr; i++) {
+    for (j = 0; j < nlc; j++)
+      error = MAX(error, fabs(c[i][j]));
+  }
+  MPI_Reduce(&error, &max_error, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+  if (pid == 0)
+    printf("Maximum error in A*A^-1 - I = %e\n", max_error);
+
+  vecfreei(pi);
+  matfreed(c);
+  matfreed(a0);
+  matfreed(a);
+  mpigrid_free(grid);
+
+  MPI_Finalize();
+
+  exit(0);
+
+} /* end main */
@@ -0,0 +1,118 @@
+#include "mpiedupack.h"
+#include "mpigrid.h"
+
+MPI_Datatype mpilu_filetype(struct mpigrid *grid, int n, int b) {
+  /* Return the committed datatype that selects the local part of P(s,t)
+     from an n by n matrix stored by rows, in the M by N block-cyclic
+     distribution with b by b blocks of grid. The local part consists
+     of nloc(M,s,n,b) by nloc(N,t,n,b) elements, stored by rows in
+     the order of the local indices, as in a matrix from matallocd.
+     The distributed array type of MPI numbers the processors by rows
+     of the processor grid, so P(s,t) is given as number s*N+t. */
+
+  int gsizes[2], distribs[2], dargs[2], psizes[2];
+  MPI_Datatype filetype;
+
+  gsizes[0] = gsizes[1] = n;
+  distribs[0] = distribs[1] = MPI_DISTRIBUTE_CYCLIC;
+  dargs[0] = dargs[1] = b;
+  psizes[0] = grid->M;
+  psizes[1] = grid->N;
+  MPI_Type_create_darray(grid->M * grid->N, grid->s * grid->N + grid->t, 2,
+                         gsizes, distribs, dargs, psizes, MPI_ORDER_C,
+                         MPI_DOUBLE, &filetype);
+  MPI_Type_commit(&filetype);
+
+  return filetype;
+
+} /* end mpilu_filetype */
+
+void mpilu_matrixio(struct mpigrid *grid, int n, int b, char *filename,
+                    int write, double **a) {
+  /* Read (write=FALSE) or write (write=TRUE) the n by n matrix A,
+     distributed by the M by N block-cyclic distribution with b by b
+     blocks of grid, from or to the file filename, which holds A
+     as n*n doubles in native representation, stored by rows.
+     Every processor reads or writes its own local part directly,
+     in one collective call, so that no data pass through another
+     processor. All processors of grid must call this function. */
+
+  int nloc(int p, int s, int n, int b);
+  MPI_Datatype mpilu_filetype(struct mpigrid *grid, int n, int b);
+  int nlr, nlc, err;
+  double dummy, *x;
+
+  MPI_Datatype filetype, rowtype;
+  MPI_File fh;
+
+  nlr = nloc(grid->M, grid->s, n, b); /* number of local rows */
+  nlc = nloc(grid->N, grid->t, n, b); /* number of local columns */
+
+  /* A local row is one element of the data, so that the count
+     stays small even if the local part has more than 2^31 elements */
+  MPI_Type_contiguous(nlc, MPI_DOUBLE, &rowtype);
+  MPI_Type_commit(&rowtype);
+  filetype = mpilu_filetype(grid, n, b);
+  x = (nlr > 0 && nlc > 0 ? a[0] : &dummy);
+
+  err = MPI_File_open(grid->comm, filename,
+                      (write ? MPI_MODE_CREATE | MPI_MODE_WRONLY
+                             : MPI_MODE_RDONLY),
+                      MPI_INFO_NULL, &fh);
+  if (err != MPI_SUCCESS)
+    MPI_Abort(MPI_COMM_WORLD, -16);
+  if (write) /* discard the old contents of a longer file */
+    MPI_File_set_size(fh, 0);
+  MPI_File_set_view(fh, 0, MPI_DOUBLE, filetype, "native", MPI_INFO_NULL);
+  if (write)
+    err = MPI_File_write_all(fh, x, (nlc > 0 ? nlr : 0), rowtype,
+                             MPI_STATUS_IGNORE);
+  else
+    err = MPI_File_read_all(fh, x, (nlc > 0 ? nlr : 0), rowtype,
+                            MPI_STATUS_IGNORE);
+  if (err != MPI_SUCCESS)
+    MPI_Abort(MPI_COMM_WORLD, -16);
+  MPI_File_close(&fh);
+
+  MPI_Type_free(&filetype);
+  MPI_Type_free(&rowtype);
+
+} /* end mpilu_matrixio */
+
+void mpilu_writepi(struct mpigrid *grid, int n, int b, char *filename,
+                   int *pi) {
+  /* Write the permutation pi of mpilu, distributed by the block-cyclic
+     distribution with block size b over the processors P(*,0),
+     to the file filename, as n ints in native representation.
+     All processors of grid must call this function. */
+
+  int nloc(int p, int s, int n, int b);
+  int nlr, err, gsize, distrib, darg, psize, dummy;
+
+  MPI_Datatype filetype;
+  MPI_File fh;
+
+  nlr = (grid->t == 0 ? nloc(grid->M, grid->s, n, b) : 0);
+  gsize = n;
+  distrib = MPI_DISTRIBUTE_CYCLIC;
+  darg = b;
+  psize = grid->M;
+  MPI_Type_create_darray(grid->M, grid->s, 1, &gsize, &distrib, &darg,
+                         &psize, MPI_ORDER_C, MPI_INT, &filetype);
+  MPI_Type_commit(&filetype);
+
+  err = MPI_File_open(grid->comm, filename, MPI_MODE_CREATE | MPI_MODE_WRONLY,
+                      MPI_INFO_NULL, &fh);
+  if (err != MPI_SUCCESS)
+    MPI_Abort(MPI_COMM_WORLD, -16);
+  MPI_File_set_size(fh, 0); /* discard the old contents of the file */
+  MPI_File_set_view(fh, 0, MPI_INT, filetype, "native", MPI_INFO_NULL);
+  err = MPI_File_write_all(fh, (nlr > 0 ? pi : &dummy), nlr, MPI_INT,
+                           MPI_STATUS_IGNORE);
+  if (err != MPI_SUCCESS)
+    MPI_Abort(MPI_COMM_WORLD, -16);
+  MPI_File_close(&fh);
+
+  MPI_Type_free(&filetype);
+
+} /* end mpilu_writepi */
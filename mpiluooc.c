@@ -0,0 +1,330 @@
+#include "mpiedupack.h"
+#include "mpigrid.h"
+#include <aio.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+void mpilu_oocread(int fd, off_t pos, size_t count, double *buf,
+                   struct aiocb *cb) {
+  /* Start the asynchronous read of count doubles at byte position pos
+     of file fd into buf. The read is completed by mpilu_oocwait. */
+
+  memset(cb, 0, sizeof(struct aiocb));
+  cb->aio_fildes = fd;
+  cb->aio_offset = pos;
+  cb->aio_buf = buf;
+  cb->aio_nbytes = count * SZDBL;
+  if (count > 0 && aio_read(cb) != 0)
+    MPI_Abort(MPI_COMM_WORLD, -16);
+
+} /* end mpilu_oocread */
+
+void mpilu_oocwait(struct aiocb *cb) {
+  /* Wait until the read started by mpilu_oocread has completed */
+  const struct aiocb *list[1];
+
+  if (cb->aio_nbytes == 0)
+    return;
+  list[0] = cb;
+  while (aio_error(cb) == EINPROGRESS)
+    aio_suspend(list, 1, NULL);
+  if (aio_return(cb) != (ssize_t)cb->aio_nbytes)
+    MPI_Abort(MPI_COMM_WORLD, -16);
+
+} /* end mpilu_oocwait */
+
+void mpilu_oocwrite(int fd, off_t pos, size_t count, double *buf) {
+  /* Write count doubles from buf at byte position pos of file fd */
+  char *x;
+  size_t left;
+  ssize_t len;
+
+  x = (char *)buf;
+  left = count * SZDBL;
+  while (left > 0) {
+    len = pwrite(fd, x, left, pos);
+    if (len <= 0)
+      MPI_Abort(MPI_COMM_WORLD, -16);
+    x += len;
+    pos += len;
+    left -= len;
+  }
+
+} /* end mpilu_oocwrite */
+
+off_t mpilu_ooclpos(int M, int s, int b, int nb, int nlr, int k0) {
+  /* Return the byte position in the scratch file of mpilu_ooc
+     of the factored panel that starts at column k0 */
+
+  int nloc(int p, int s, int n, int b);
+  int j0, kb;
+  off_t pos;
+
+  pos = 0;
+  for (j0 = 0; j0 < k0; j0 += nb) {
+    kb = MIN(nb, k0 - j0);
+    pos += ((off_t)kb * kb + (off_t)(nlr - nloc(M, s, j0, b)) * kb) * SZDBL;
+  }
+  return pos;
+
+} /* end mpilu_ooclpos */
+
+void mpilu_ooc(struct mpigrid *grid, int n, int b, int nb, int *pi, int fd,
+               int fdl) {
+  /* Compute LU decomposition of n by n matrix A with partial pivoting,
+     using panels of nb columns, with my local part of A kept in
+     the file fd instead of in memory. The distribution and pivots
+     are those of mpilu_blocked, and so is the output in pi.
+
+     The file fd holds my local part in panel-major order: for every
+     panel of nb columns k0 <= k < k0+nb in turn, my nlr local rows
+     of my local columns kc0 <= j < kce of the panel, stored by rows,
+     where nlr = nloc(M,s,n,b), kc0 = nloc(N,t,k0,b) and
+     kce = nloc(N,t,k0+nb,b). The local element (i,j) is thus at
+     position nlr*kc0 + i*(kce-kc0) + j-kc0. On output, the file
+     holds L\U in the same order.
+     The file fdl is used as scratch space for the factored panels,
+     about n*n/(2*M) + n*nb doubles, and must be opened for reading
+     and writing.
+
+     The panels are factored from left to right, each panel being
+     updated on arrival with all the factored panels before it
+     (left-looking), so that only two panels of the matrix and two
+     factored panels are in memory at any time. Together with the
+     gathered panel P and the two communication buffers, which have
+     the same size, this is about 7*nlr*nb doubles. The next panel
+     or factored panel to be used is read asynchronously, while
+     the current one is being used.
+     The row interchanges of a panel are applied to the panels
+     to its left only at the end, in one extra pass over the file.
+  */
+
+  int nloc(int p, int s, int n, int b);
+  int owner(int p, int k, int b);
+  int gindex(int p, int s, int i, int b);
+  void mm_sub(int m, int n, int kb, double **l, double **u, double **c,
+              int jc);
+  void mpilu_laswp(int M, int s, int b, int nlc, int kc0, int kce, int k0,
+                   int kb, int *piv, int *pi, double **a, MPI_Comm col_comm_t);
+  void mpilu_factorpanel(int M, int s, int b, int n, int nlr, int k0, int kb,
+                         double **P, double **LU11, int *piv, double *prow,
+                         MPI_Comm col_comm_t);
+  void mpilu_bcastpanel(int M, int s, int t, int b, int nlr, int k0, int kb,
+                        double **P, double **LU11, int *piv, double *buf,
+                        int root, MPI_Comm row_comm_s);
+  void mpilu_getu(int M, int s, int b, int k0, int kb, int c0, int c1,
+                  double **a, double **U, double *buf, double *buf1,
+                  int *cnt, int *displ, MPI_Comm col_comm_t);
+  void mpilu_oocread(int fd, off_t pos, size_t count, double *buf,
+                     struct aiocb *cb);
+  void mpilu_oocwait(struct aiocb *cb);
+  void mpilu_oocwrite(int fd, off_t pos, size_t count, double *buf);
+  off_t mpilu_ooclpos(int M, int s, int b, int nb, int nlr, int k0);
+  double **P, **U, **LU11, **A, **L, **D, *pbuf[2], *lbuf[2], *prow, *buf,
+      *buf1, *src;
+  int M, N, s, t, nlr, np, K, J, k0, kb, kr0, kc0, kce, nc, j0, jb, jr0,
+      jre, nrows, kk, jj, i, j, q, tp, *piv, *cnt, *displ;
+  size_t lsize;
+
+  struct aiocb pcb[2], lcb[2];
+  MPI_Comm row_comm_s, col_comm_t;
+
+  M = grid->M;
+  N = grid->N;
+  s = grid->s;
+  t = grid->t;
+  row_comm_s = grid->row_comm;
+  col_comm_t = grid->col_comm;
+
+  nlr = nloc(M, s, n, b); /* number of local rows */
+  np = (n + nb - 1) / nb; /* number of panels */
+  lsize = (size_t)nb * nb + (size_t)nlr * nb; /* room for a factored panel */
+
+  pbuf[0] = vecallocd(nlr * nb);
+  pbuf[1] = vecallocd(nlr * nb);
+  lbuf[0] = vecallocd(lsize);
+  lbuf[1] = vecallocd(lsize);
+  P = matallocd(nlr, nb);
+  U = matallocd(nb, nb);
+  LU11 = matallocd(nb, nb);
+  prow = vecallocd(nb);
+  buf = vecallocd((nlr + nb + 1) * nb);
+  buf1 = vecallocd(MAX(nlr, nb) * nb);
+  piv = vecalloci(n); /* piv[k] = row swapped with row k */
+  cnt = vecalloci(MAX(M, N));
+  displ = vecalloci(MAX(M, N));
+  A = (double **)malloc(MAX(nlr, 1) * sizeof(double *));
+  L = (double **)malloc(MAX(nlr, 1) * sizeof(double *));
+  D = (double **)malloc(nb * sizeof(double *));
+  if (A == NULL || L == NULL || D == NULL)
+    MPI_Abort(MPI_COMM_WORLD, -13);
+
+  /* Initialize permutation vector pi */
+  if (t == 0) {
+    for (i = 0; i < nlr; i++)
+      pi[i] = gindex(M, s, i, b); /* global row index */
+  }
+
+  mpilu_oocread(fd, 0, (size_t)nlr * nloc(N, t, MIN(nb, n), b), pbuf[0],
+                &pcb[0]);
+
+  for (K = 0; K < np; K++) {
+    k0 = K * nb;
+    kb = MIN(nb, n - k0); /* number of columns of the panel */
+    kr0 = nloc(M, s, k0, b);
+    kc0 = nloc(N, t, k0, b);
+    kce = nloc(N, t, k0 + kb, b);
+    nc = kce - kc0; /* number of my columns of the panel */
+
+    /* Wait for my part of the panel and prefetch the next item */
+    mpilu_oocwait(&pcb[K % 2]);
+    for (i = 0; i < nlr; i++)
+      A[i] = pbuf[K % 2] + (size_t)i * nc;
+    if (K > 0) {
+      mpilu_oocread(fdl, 0, (size_t)nb * nb + (size_t)nlr * nb, lbuf[0],
+                    &lcb[0]);
+    } else if (np > 1) {
+      mpilu_oocread(fd, (off_t)nlr * kce * SZDBL,
+                    (size_t)nlr * (nloc(N, t, MIN(2 * nb, n), b) - kce),
+                    pbuf[1], &pcb[1]);
+    }
+
+    /* Update the panel with the factored panels to its left */
+    for (J = 0; J < K; J++) {
+      j0 = J * nb;
+      jb = nb; /* a panel to the left is complete */
+      jr0 = nloc(M, s, j0, b);
+      jre = nloc(M, s, j0 + jb, b);
+
+      mpilu_oocwait(&lcb[J % 2]);
+      if (J + 1 < K) {
+        mpilu_oocread(fdl, mpilu_ooclpos(M, s, b, nb, nlr, j0 + jb),
+                      (size_t)jb * jb + (size_t)(nlr - jre) * jb,
+                      lbuf[(J + 1) % 2], &lcb[(J + 1) % 2]);
+      } else if (K + 1 < np) {
+        mpilu_oocread(fd, (off_t)nlr * kce * SZDBL,
+                      (size_t)nlr * (nloc(N, t, MIN(k0 + 2 * nb, n), b) - kce),
+                      pbuf[(K + 1) % 2], &pcb[(K + 1) % 2]);
+      }
+      for (kk = 0; kk < jb; kk++)
+        D[kk] = lbuf[J % 2] + kk * jb;
+      for (i = jr0; i < nlr; i++)
+        L[i] = lbuf[J % 2] + jb * jb + (size_t)(i - jr0) * jb;
+
+      /* Swap the rows of the panel and compute its part of U */
+      mpilu_laswp(M, s, b, nc, 0, 0, j0, jb, &piv[j0], NULL, A, col_comm_t);
+      mpilu_getu(M, s, b, j0, jb, 0, nc, A, U, buf, buf1, cnt, displ,
+                 col_comm_t);
+      for (kk = 1; kk < jb; kk++) {
+        for (jj = 0; jj < kk; jj++) {
+          for (j = 0; j < nc; j++)
+            U[kk][j] -= D[kk][jj] * U[jj][j];
+        }
+      }
+      for (i = jr0; i < jre; i++) {
+        for (j = 0; j < nc; j++)
+          A[i][j] = U[gindex(M, s, i, b) - j0][j];
+      }
+      mm_sub(nlr - jre, nc, jb, &L[jre], U, &A[jre], 0);
+    }
+
+    /****** Superstep 0. Gather the panel in processor column tp ******/
+    tp = owner(N, k0, b);
+    nrows = nlr - kr0;
+    for (j = 0; j < nc; j++) {
+      for (i = kr0; i < nlr; i++)
+        buf[j * nrows + i - kr0] = A[i][j];
+    }
+    for (q = 0; q < N; q++)
+      cnt[q] = (nloc(N, q, k0 + kb, b) - nloc(N, q, k0, b)) * nrows;
+    displ[0] = 0;
+    for (q = 1; q < N; q++)
+      displ[q] = displ[q - 1] + cnt[q - 1];
+    src = buf; /* the panel lies within processor column tp */
+    if (cnt[tp] < kb * nrows) {
+      MPI_Gatherv(buf, cnt[t], MPI_DOUBLE, buf1, cnt, displ, MPI_DOUBLE, tp,
+                  row_comm_s);
+      src = buf1;
+    }
+
+    /****** Superstep 1. Factor the panel in processor column tp ******/
+    if (t == tp) {
+      for (q = 0; q < N; q++) {
+        for (jj = 0; jj < nloc(N, q, k0 + kb, b) - nloc(N, q, k0, b);
+             jj++) {
+          j = gindex(N, q, nloc(N, q, k0, b) + jj, b);
+          for (i = kr0; i < nlr; i++)
+            P[i][j - k0] = src[displ[q] + jj * nrows + i - kr0];
+        }
+      }
+      mpilu_factorpanel(M, s, b, n, nlr, k0, kb, P, LU11, &piv[k0], prow,
+                        col_comm_t);
+    }
+    mpilu_bcastpanel(M, s, t, b, nlr, k0, kb, P, LU11, &piv[k0], buf, tp,
+                     row_comm_s);
+
+    /* Write my columns of the factored panel, and the factored panel
+       for the panels to its right, using the free buffer lbuf[0] */
+    for (i = kr0; i < nlr; i++) {
+      for (j = 0; j < nc; j++)
+        A[i][j] = P[i][gindex(N, t, kc0 + j, b) - k0];
+    }
+    mpilu_oocwrite(fd, (off_t)nlr * kc0 * SZDBL, (size_t)nlr * nc,
+                   pbuf[K % 2]);
+    for (kk = 0; kk < kb; kk++) {
+      for (j = 0; j < kb; j++)
+        lbuf[0][kk * kb + j] = LU11[kk][j];
+    }
+    for (i = kr0; i < nlr; i++) {
+      for (j = 0; j < kb; j++)
+        lbuf[0][kb * kb + (size_t)(i - kr0) * kb + j] = P[i][j];
+    }
+    mpilu_oocwrite(fdl, mpilu_ooclpos(M, s, b, nb, nlr, k0),
+                   (size_t)kb * kb + (size_t)nrows * kb, lbuf[0]);
+
+    /****** Superstep 2. Swap the rows of pi ******/
+    if (t == 0)
+      mpilu_laswp(M, s, b, 0, 0, 0, k0, kb, &piv[k0], pi, NULL, col_comm_t);
+  }
+
+  /* Apply the row interchanges of every panel to the panels to its left */
+  if (np > 1)
+    mpilu_oocread(fd, 0, (size_t)nlr * nloc(N, t, nb, b), pbuf[0], &pcb[0]);
+  for (J = 0; J < np - 1; J++) {
+    j0 = J * nb;
+    kc0 = nloc(N, t, j0, b);
+    kce = nloc(N, t, j0 + nb, b);
+    nc = kce - kc0;
+    mpilu_oocwait(&pcb[J % 2]);
+    if (J + 2 < np)
+      mpilu_oocread(fd, (off_t)nlr * kce * SZDBL,
+                    (size_t)nlr * (nloc(N, t, j0 + 2 * nb, b) - kce),
+                    pbuf[(J + 1) % 2], &pcb[(J + 1) % 2]);
+    for (i = 0; i < nlr; i++)
+      A[i] = pbuf[J % 2] + (size_t)i * nc;
+    for (k0 = j0 + nb; k0 < n; k0 += nb)
+      mpilu_laswp(M, s, b, nc, 0, 0, k0, MIN(nb, n - k0), &piv[k0], NULL, A,
+                  col_comm_t);
+    mpilu_oocwrite(fd, (off_t)nlr * kc0 * SZDBL, (size_t)nlr * nc,
+                   pbuf[J % 2]);
+  }
+
+  free(D);
+  free(L);
+  free(A);
+  vecfreei(displ);
+  vecfreei(cnt);
+  vecfreei(piv);
+  vecfreed(buf1);
+  vecfreed(buf);
+  vecfreed(prow);
+  matfreed(LU11);
+  matfreed(U);
+  matfreed(P);
+  vecfreed(lbuf[1]);
+  vecfreed(lbuf[0]);
+  vecfreed(pbuf[1]);
+  vecfreed(pbuf[0]);
+
+} /* end mpilu_ooc */
@@ -0,0 +1,192 @@
+#include "mpiedupack.h"
+#include "mpigrid.h"
+#include <fcntl.h>
+#include <unistd.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/*  This is a test program which uses mpilu_ooc to decompose an n by n
+    matrix A that is kept in files on local disk, one per processor,
+    in the directory given as input.
+
+    The input matrix A is a pseudo-random matrix with elements
+    in [-1,1], computed from the global indices, so that every
+    processor can write its own part of A to its file, one panel
+    at a time, without holding A in memory. Meanwhile, the right-hand
+    side B = AX is computed for the exact solution X given by
+    X(i)= 1 + i mod 3.
+
+    The time and computing rate of the decomposition are printed.
+    If requested, the factors are read back into memory and the
+    system AX = B is solved by mpilu_solve, and the maximum error
+    in X is printed; this needs room for the local matrix in memory.
+    The files are removed at the end.
+*/
+
+double testmat(int i, int j) {
+  /* Return the element A(i,j) of the test matrix */
+  unsigned int x;
+
+  x = (unsigned int)i * 2654435761u ^ ((unsigned int)j * 40503u + 7u);
+  x ^= x >> 13;
+  x *= 0x5bd1e995u;
+  x ^= x >> 15;
+  return (x % 10000) / 5000.0 - 1.0;
+
+} /* end testmat */
+
+int main(int argc, char **argv) {
+
+  struct mpigrid *mpigrid_create(int M, int N, MPI_Comm comm);
+  void mpigrid_free(struct mpigrid *grid);
+  int nloc(int p, int s, int n, int b);
+  int gindex(int p, int s, int i, int b);
+  double testmat(int i, int j);
+  void mpilu_ooc(struct mpigrid *grid, int n, int b, int nb, int *pi, int fd,
+                 int fdl);
+  void mpilu_oocwrite(int fd, off_t pos, size_t count, double *buf);
+  void mpilu_solve(struct mpigrid *grid, int n, int b, int nrhs, int *pi,
+                   double **a, double **x);
+  int p, pid, provided, M, N, s, t, n, b, nb, check, nlr, nlc, kc0, kce, nc,
+      k0, i, j, iglob, fd, fdl, *pi;
+  double **a, **x, *pbuf, *y, time0, time1, error, max_error;
+  char dir[256], name[300], namel[300];
+  struct mpigrid *grid;
+
+  /* Only the master thread of each processor communicates */
+  MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+#ifdef _OPENMP
+  if (provided < MPI_THREAD_FUNNELED)
+    omp_set_num_threads(1);
+#endif
+
+  MPI_Comm_size(MPI_COMM_WORLD, &p);
+  MPI_Comm_rank(MPI_COMM_WORLD, &pid);
+
+  if (pid == 0) {
+    printf("Please enter number of processor rows M:\n");
+    scanf("%d", &M);
+    printf("Please enter number of processor columns N:\n");
+    scanf("%d", &N);
+    if (M * N != p)
+      MPI_Abort(MPI_COMM_WORLD, -5);
+    printf("Please enter matrix size n:\n");
+    scanf("%d", &n);
+    printf("Please enter distribution block size b:\n");
+    scanf("%d", &b);
+    if (b < 1)
+      MPI_Abort(MPI_COMM_WORLD, -12);
+    printf("Please enter panel width nb:\n");
+    scanf("%d", &nb);
+    if (nb < 1)
+      MPI_Abort(MPI_COMM_WORLD, -12);
+    printf("Please enter directory for the matrix files:\n");
+    scanf("%255s", dir);
+    printf("Please enter 1 to check the solution in memory, 0 otherwise:\n");
+    scanf("%d", &check);
+  }
+  MPI_Bcast(&M, 1, MPI_INT, 0, MPI_COMM_WORLD);
+  MPI_Bcast(&N, 1, MPI_INT, 0, MPI_COMM_WORLD);
+  MPI_Bcast(&n, 1, MPI_INT, 0, MPI_COMM_WORLD);
+  MPI_Bcast(&b, 1, MPI_INT, 0, MPI_COMM_WORLD);
+  MPI_Bcast(&nb, 1, MPI_INT, 0, MPI_COMM_WORLD);
+  MPI_Bcast(dir, 256, MPI_CHAR, 0, MPI_COMM_WORLD);
+  MPI_Bcast(&check, 1, MPI_INT, 0, MPI_COMM_WORLD);
+
+  grid = mpigrid_create(M, N, MPI_COMM_WORLD);
+  s = grid->s;
+  t = grid->t;
+  nlr = nloc(M, s, n, b);
+  nlc = nloc(N, t, n, b);
+
+  sprintf(name, "%s/luooc.%d", dir, pid);
+  sprintf(namel, "%s/luooc.%d.L", dir, pid);
+  fd = open(name, O_RDWR | O_CREAT | O_TRUNC, 0600);
+  fdl = open(namel, O_RDWR | O_CREAT | O_TRUNC, 0600);
+  if (fd < 0 || fdl < 0)
+    MPI_Abort(MPI_COMM_WORLD, -16);
+
+  /* Write my part of A panel by panel and compute my part of B = AX */
+  pbuf = vecallocd(nlr * nb);
+  y = vecallocd(nlr);
+  x = matallocd(nlr, 1);
+  pi = vecalloci(nlr);
+  for (i = 0; i < nlr; i++)
+    y[i] = 0.0;
+  for (k0 = 0; k0 < n; k0 += nb) {
+    kc0 = nloc(N, t, k0, b);
+    kce = nloc(N, t, MIN(k0 + nb, n), b);
+    nc = kce - kc0;
+    for (i = 0; i < nlr; i++) {
+      iglob = gindex(M, s, i, b);
+      for (j = kc0; j < kce; j++) {
+        pbuf[i * nc + j - kc0] = testmat(iglob, gindex(N, t, j, b));
+        y[i] += pbuf[i * nc + j - kc0] * (1 + gindex(N, t, j, b) % 3);
+      }
+    }
+    mpilu_oocwrite(fd, (off_t)nlr * kc0 * SZDBL, (size_t)nlr * nc, pbuf);
+  }
+  MPI_Allreduce(y, x[0], nlr, MPI_DOUBLE, MPI_SUM, grid->row_comm);
+  if (pid == 0) {
+    printf("Out-of-core LU decomposition of %d by %d matrix\n", n, n);
+    printf("on %d by %d grid with %d by %d blocks and panels of %d columns\n",
+           M, N, b, b, nb);
+    printf("Files: %s/luooc.*, %.1lf MB per processor\n", dir,
+           (double)nlr * nlc * SZDBL / 1.0e6);
+  }
+
+  MPI_Barrier(MPI_COMM_WORLD);
+  time0 = MPI_Wtime();
+  mpilu_ooc(grid, n, b, nb, pi, fd, fdl);
+  MPI_Barrier(MPI_COMM_WORLD);
+  time1 = MPI_Wtime();
+
+  if (pid == 0) {
+    printf("This took only %.6lf seconds.\n", time1 - time0);
+    printf("Computing rate = %.3lf Gflop/s\n",
+           2.0 * n * (double)n * n / (3.0 * (time1 - time0) * 1.0e9));
+  }
+
+  if (check) {
+    /* Read L\U back into memory and solve AX = B */
+    a = matallocd(nlr, nlc);
+    for (k0 = 0; k0 < n; k0 += nb) {
+      kc0 = nloc(N, t, k0, b);
+      kce = nloc(N, t, MIN(k0 + nb, n), b);
+      nc = kce - kc0;
+      if ((size_t)pread(fd, pbuf, (size_t)nlr * nc * SZDBL,
+                        (off_t)nlr * kc0 * SZDBL) != (size_t)nlr * nc * SZDBL)
+        MPI_Abort(MPI_COMM_WORLD, -16);
+      for (i = 0; i < nlr; i++) {
+        for (j = kc0; j < kce; j++)
+          a[i][j] = pbuf[i * nc + j - kc0];
+      }
+    }
+    mpilu_solve(grid, n, b, 1, pi, a, x);
+    error = 0.0;
+    for (i = 0; i < nlr; i++) {
+      iglob = gindex(M, s, i, b);
+      error = MAX(error, fabs(x[i][0] - (1 + iglob % 3)));
+    }
+    MPI_Reduce(&error, &max_error, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+    if (pid == 0)
+      printf("Maximum error in X = %e\n", max_error);
+    matfreed(a);
+  }
+
+  close(fdl);
+  close(fd);
+  unlink(namel);
+  unlink(name);
+  vecfreei(pi);
+  matfreed(x);
+  vecfreed(y);
+  vecfreed(pbuf);
+  mpigrid_free(grid);
+
+  MPI_Finalize();
+
+  exit(0);
+
+} /* end main */
@@ -0,0 +1,130 @@
+#include "mpiedupack.h"
+#include "mpigrid.h"
+
+void mpimm(struct mpigrid *grid, int m, int n, int k, int b, int nb,
+           int bcast, double **a, double **bm, double **c) {
+  /* Compute C += A*B, where A is an m by k matrix, B a k by n matrix
+     and C an m by n matrix, all distributed according to the M by N
+     block-cyclic distribution with b by b blocks of grid, as in mpilu.
+     For b=1 this is the M by N cyclic distribution.
+     Program text for P(s,t).
+
+     The product is computed as a sum of rank-kb updates, with kb <= nb,
+     as in the SUMMA algorithm: for every panel of kb columns of A
+     and the same kb rows of B, the owners broadcast the local part of
+     the panel of A within their processor row and the local part of
+     the rows of B within their processor column, and every processor
+     updates its local part of C by mm_sub, which works on strips
+     of C that stay in cache.
+
+     To obtain a single owner of each panel, in both directions,
+     the blocks K = k div b are grouped by K mod lcm(M,N): all blocks
+     of a group are owned by the same processor column of A and
+     the same processor row of B, and every panel is taken from one
+     group, independently of the block size b. The broadcasts use
+     algorithm bcast, as in mpilu: BCAST_MPI uses the MPI library,
+     and the ring algorithms of mpilu_bcast send a panel in pipelined
+     segments, so that a processor already updates C while it is still
+     forwarding the panel to its successors.
+  */
+
+  int nloc(int p, int s, int n, int b);
+  int lindex(int p, int k, int b);
+  void mm_sub(int m, int n, int kb, double **l, double **u, double **c,
+              int jc);
+  void mpilu_bcast(double *x, int count, int root, MPI_Comm comm, int alg,
+                   MPI_Request *request, int *nreq);
+  int M, N, s, t, ncm, nrc, ncc, g, r, q, K, j, kk, kb, i, jj, nreq,
+      *kidx;
+  double *ap, *bp, **A, **B;
+
+  MPI_Request *request;
+  MPI_Comm row_comm_s, col_comm_t;
+
+  M = grid->M;
+  N = grid->N;
+  s = grid->s;
+  t = grid->t;
+  row_comm_s = grid->row_comm;
+  col_comm_t = grid->col_comm;
+
+  nrc = nloc(M, s, m, b); /* number of local rows of A and C */
+  ncc = nloc(N, t, n, b); /* number of local columns of B and C */
+
+  /* ncm = lcm(M,N) */
+  for (ncm = M; ncm % N != 0; ncm += M)
+    ;
+
+  ap = vecallocd(nrc * nb);
+  bp = vecallocd(nb * ncc);
+  kidx = vecalloci(nb);
+  A = (double **)malloc(MAX(nrc, 1) * sizeof(double *));
+  B = (double **)malloc(nb * sizeof(double *));
+  request = (MPI_Request *)malloc(
+      2 * ((nrc * nb + nb * ncc) / BCASTSEG + 2) * sizeof(MPI_Request));
+  if (A == NULL || B == NULL || request == NULL)
+    MPI_Abort(MPI_COMM_WORLD, -13);
+  nreq = 0;
+
+  for (g = 0; g < ncm; g++) {
+    r = g % N; /* processor column that owns the columns of A */
+    q = g % M; /* processor row that owns the rows of B */
+    K = g;     /* current block of the group */
+    j = 0;     /* current column within block K */
+
+    while (K * b < k) {
+      /* Collect the global indices of the next panel */
+      kb = 0;
+      while (kb < nb && K * b < k) {
+        kidx[kb++] = K * b + j;
+        j++;
+        if (j == b || K * b + j == k) {
+          K += ncm;
+          j = 0;
+        }
+      }
+
+      /* The buffers may only be changed when forwarding is done */
+      MPI_Waitall(nreq, request, MPI_STATUSES_IGNORE);
+      nreq = 0;
+
+      /****** Superstep 0. Broadcast the panels ******/
+      if (t == r) {
+        /* The panel of A is stored negated, so that mm_sub adds */
+        for (i = 0; i < nrc; i++) {
+          for (kk = 0; kk < kb; kk++)
+            ap[i * kb + kk] = -a[i][lindex(N, kidx[kk], b)];
+        }
+      }
+      if (s == q) {
+        for (kk = 0; kk < kb; kk++) {
+          for (jj = 0; jj < ncc; jj++)
+            bp[kk * ncc + jj] = bm[lindex(M, kidx[kk], b)][jj];
+        }
+      }
+      if (bcast == BCAST_MPI) {
+        MPI_Bcast(ap, nrc * kb, MPI_DOUBLE, r, row_comm_s);
+        MPI_Bcast(bp, kb * ncc, MPI_DOUBLE, q, col_comm_t);
+      } else {
+        mpilu_bcast(ap, nrc * kb, r, row_comm_s, bcast, request, &nreq);
+        mpilu_bcast(bp, kb * ncc, q, col_comm_t, bcast, request, &nreq);
+      }
+
+      /****** Superstep 1. Update C ******/
+      for (i = 0; i < nrc; i++)
+        A[i] = &ap[i * kb];
+      for (kk = 0; kk < kb; kk++)
+        B[kk] = &bp[kk * ncc];
+      mm_sub(nrc, ncc, kb, A, B, c, 0);
+    }
+  }
+  MPI_Waitall(nreq, request, MPI_STATUSES_IGNORE);
+
+  free(request);
+  free(B);
+  free(A);
+  vecfreei(kidx);
+  vecfreed(bp);
+  vecfreed(ap);
+
+} /* end mpimm */
@@ -0,0 +1,166 @@
+#include "mpiedupack.h"
+#include "mpigrid.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/*  This is a test program which uses mpimm to compute C += A*B,
+    where A is an m by k matrix, B a k by n matrix and C an m by n
+    matrix, distributed over an M by N processor grid with b by b
+    blocks. The matrices A and B are pseudo-random matrices with
+    elements in [-1,1], computed from the global indices, and C is
+    initially zero.
+
+    The product is computed NITERS times, after one run to warm up,
+    and the average time and the computing rate 2*m*n*k/time
+    are printed. Afterwards, the first CHECKROWS local rows of C
+    of every processor are compared with the product computed
+    directly from the elements of A and B, and the maximum error
+    is printed.
+*/
+
+#define NITERS 3
+#define CHECKROWS 4
+
+double mmmat(int which, int i, int j) {
+  /* Return the element (i,j) of the test matrix A (which=0)
+     or B (which=1) */
+  unsigned int x;
+
+  x = (unsigned int)i * 2654435761u ^ ((unsigned int)j * 40503u + 7u) ^
+      ((unsigned int)which * 97531u);
+  x ^= x >> 13;
+  x *= 0x5bd1e995u;
+  x ^= x >> 15;
+  return (x % 10000) / 5000.0 - 1.0;
+
+} /* end mmmat */
+
+int main(int argc, char **argv) {
+
+  struct mpigrid *mpigrid_create(int M, int N, MPI_Comm comm);
+  void mpigrid_free(struct mpigrid *grid);
+  int nloc(int p, int s, int n, int b);
+  int gindex(int p, int s, int i, int b);
+  double mmmat(int which, int i, int j);
+  void mpimm(struct mpigrid *grid, int m, int n, int k, int b, int nb,
+             int bcast, double **a, double **bm, double **c);
+  int p, pid, provided, M, N, s, t, m, n, k, b, nb, bcast, iter, i, j, kk,
+      nra, nca, nrb, ncb, ig, jg;
+  double **a, **bm, **c, time0, time1, time, sum, error, max_error;
+  struct mpigrid *grid;
+
+  /* Only the master thread of each processor communicates */
+  MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+#ifdef _OPENMP
+  if (provided < MPI_THREAD_FUNNELED)
+    omp_set_num_threads(1);
+#endif
+
+  MPI_Comm_size(MPI_COMM_WORLD, &p);
+  MPI_Comm_rank(MPI_COMM_WORLD, &pid);
+
+  if (pid == 0) {
+    printf("Please enter number of processor rows M:\n");
+    scanf("%d", &M);
+    printf("Please enter number of processor columns N:\n");
+    scanf("%d", &N);
+    if (M * N != p)
+      MPI_Abort(MPI_COMM_WORLD, -5);
+    printf("Please enter matrix sizes m n k:\n");
+    scanf("%d %d %d", &m, &n, &k);
+    printf("Please enter distribution block size b:\n");
+    scanf("%d", &b);
+    if (b < 1)
+      MPI_Abort(MPI_COMM_WORLD, -12);
+    printf("Please enter panel width nb:\n");
+    scanf("%d", &nb);
+    if (nb < 1)
+      MPI_Abort(MPI_COMM_WORLD, -12);
+    printf("Please enter broadcast algorithm (0-3):\n");
+    scanf("%d", &bcast);
+    if (bcast < 0 || bcast > 3)
+      MPI_Abort(MPI_COMM_WORLD, -14);
+  }
+  MPI_Bcast(&M, 1, MPI_INT, 0, MPI_COMM_WORLD);
+  MPI_Bcast(&N, 1, MPI_INT, 0, MPI_COMM_WORLD);
+  MPI_Bcast(&m, 1, MPI_INT, 0, MPI_COMM_WORLD);
+  MPI_Bcast(&n, 1, MPI_INT, 0, MPI_COMM_WORLD);
+  MPI_Bcast(&k, 1, MPI_INT, 0, MPI_COMM_WORLD);
+  MPI_Bcast(&b, 1, MPI_INT, 0, MPI_COMM_WORLD);
+  MPI_Bcast(&nb, 1, MPI_INT, 0, MPI_COMM_WORLD);
+  MPI_Bcast(&bcast, 1, MPI_INT, 0, MPI_COMM_WORLD);
+
+  grid = mpigrid_create(M, N, MPI_COMM_WORLD);
+  s = grid->s;
+  t = grid->t;
+  nra = nloc(M, s, m, b);
+  nca = nloc(N, t, k, b);
+  nrb = nloc(M, s, k, b);
+  ncb = nloc(N, t, n, b);
+  a = matallocd(nra, nca);
+  bm = matallocd(nrb, ncb);
+  c = matallocd(nra, ncb);
+
+  for (i = 0; i < nra; i++) {
+    for (j = 0; j < nca; j++)
+      a[i][j] = mmmat(0, gindex(M, s, i, b), gindex(N, t, j, b));
+  }
+  for (i = 0; i < nrb; i++) {
+    for (j = 0; j < ncb; j++)
+      bm[i][j] = mmmat(1, gindex(M, s, i, b), gindex(N, t, j, b));
+  }
+
+  if (pid == 0) {
+    printf("Matrix product C += A*B with m = %d, n = %d, k = %d\n", m, n, k);
+    printf("on %d by %d grid with %d by %d blocks and panels of %d columns\n",
+           M, N, b, b, nb);
+  }
+
+  time = 0.0;
+  for (iter = 0; iter <= NITERS; iter++) {
+    for (i = 0; i < nra; i++) {
+      for (j = 0; j < ncb; j++)
+        c[i][j] = 0.0;
+    }
+    MPI_Barrier(MPI_COMM_WORLD);
+    time0 = MPI_Wtime();
+    mpimm(grid, m, n, k, b, nb, bcast, a, bm, c);
+    MPI_Barrier(MPI_COMM_WORLD);
+    time1 = MPI_Wtime();
+    if (iter > 0)
+      time += (time1 - time0) / NITERS;
+  }
+
+  if (pid == 0) {
+    printf("This took only %.6lf seconds.\n", time);
+    printf("Computing rate = %.3lf Gflop/s\n",
+           2.0 * m * (double)n * k / (time * 1.0e9));
+  }
+
+  /* Check the first local rows of C */
+  error = 0.0;
+  for (i = 0; i < MIN(nra, CHECKROWS); i++) {
+    ig = gindex(M, s, i, b);
+    for (j = 0; j < ncb; j++) {
+      jg = gindex(N, t, j, b);
+      sum = 0.0;
+      for (kk = 0; kk < k; kk++)
+        sum += mmmat(0, ig, kk) * mmmat(1, kk, jg);
+      error = MAX(error, fabs(c[i][j] - sum));
+    }
+  }
+  MPI_Reduce(&error, &max_error, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+  if (pid == 0)
+    printf("Maximum error in C = %e\n", max_error);
+
+  matfreed(c);
+  matfreed(bm);
+  matfreed(a);
+  mpigrid_free(grid);
+
+  MPI_Finalize();
+
+  exit(0);
+
+} /* end main */
@@ -0,0 +1,224 @@
+#include "mpiedupack.h"
+#include "mpigrid.h"
+
+/* A matrix distribution in this file is given by a grid and a pair of
+   block sizes (br,bc): global element (i,j) is owned by P(s,t) with
+   s = (i div br) mod M and t = (j div bc) mod N, and stored there
+   at local position (lindex(M,i,br),lindex(N,j,bc)). This covers
+   the block-cyclic distribution of mpilu (br=bc=b), the cyclic
+   distribution (br=bc=1) and the block distribution
+   (br = ceil(m/M), bc = ceil(n/N)) of an m by n matrix. */
+
+void mpiredist_index(int m, int n, int M, int N, int s, int t, int br,
+                     int bc, int Mo, int No, int bro, int bco, int *rank,
+                     int p, int *count, int *displ, int *idx) {
+  /* Compute the communication pattern of my local part, of processor
+     P(s,t) of an M by N grid with block sizes (br,bc), with the
+     processors of another distribution, on an Mo by No grid with
+     block sizes (bro,bco). Processor Po(so,to) of the other grid
+     has rank rank[so+to*Mo] in the communicator of p processors.
+     Output: count[q] is the number of my local elements that are
+     owned by processor q in the other distribution, displ[q] is
+     the prefix sum of the counts, and idx[displ[q]..displ[q]+count[q]-1]
+     are the linear local indices i*nlc+j of these elements,
+     in increasing order. Since the local index is monotonic in
+     the global index, the elements that two processors exchange
+     appear in the same order, by global rows and then global columns,
+     on both sides, which makes the sender and receiver orders match.
+  */
+
+  int nloc(int p, int s, int n, int b);
+  int owner(int p, int k, int b);
+  int gindex(int p, int s, int i, int b);
+  int nlr, nlc, i, j, q, so, to, *rs, *ct, *rc, *cc, *off;
+
+  nlr = nloc(M, s, m, br);
+  nlc = nloc(N, t, n, bc);
+  rs = vecalloci(nlr);
+  ct = vecalloci(nlc);
+  rc = vecalloci(Mo);
+  cc = vecalloci(No);
+  off = vecalloci(p);
+
+  /* The owner in the other distribution of a local element follows
+     from the owner of its row and the owner of its column */
+  for (so = 0; so < Mo; so++)
+    rc[so] = 0;
+  for (to = 0; to < No; to++)
+    cc[to] = 0;
+  for (i = 0; i < nlr; i++) {
+    rs[i] = owner(Mo, gindex(M, s, i, br), bro);
+    rc[rs[i]]++;
+  }
+  for (j = 0; j < nlc; j++) {
+    ct[j] = owner(No, gindex(N, t, j, bc), bco);
+    cc[ct[j]]++;
+  }
+
+  for (q = 0; q < p; q++)
+    count[q] = 0;
+  for (to = 0; to < No; to++) {
+    for (so = 0; so < Mo; so++)
+      count[rank[so + to * Mo]] = rc[so] * cc[to];
+  }
+  displ[0] = 0;
+  for (q = 1; q < p; q++)
+    displ[q] = displ[q - 1] + count[q - 1];
+
+  for (q = 0; q < p; q++)
+    off[q] = displ[q];
+  for (i = 0; i < nlr; i++) {
+    for (j = 0; j < nlc; j++) {
+      q = rank[rs[i] + ct[j] * Mo];
+      idx[off[q]++] = i * nlc + j;
+    }
+  }
+
+  vecfreei(off);
+  vecfreei(cc);
+  vecfreei(rc);
+  vecfreei(ct);
+  vecfreei(rs);
+
+} /* end mpiredist_index */
+
+struct mpiredist *mpiredist_create(int m, int n, struct mpigrid *grid1,
+                                   int br1, int bc1, struct mpigrid *grid2,
+                                   int br2, int bc2, MPI_Comm comm) {
+  /* Create the plan for moving an m by n matrix from the distribution
+     of grid1 with block sizes (br1,bc1) to the distribution of grid2
+     with block sizes (br2,bc2). The grids may have different shapes
+     and may consist of different processors of comm, e.g. two grids
+     created by mpigrid_create from the same communicator; a processor
+     that is not part of a grid passes NULL for it.
+     All processors of comm must call this function, with the same
+     values of m, n and the block sizes.
+
+     The plan holds the counts and displacements of one MPI_Alltoallv
+     and the local indices of the elements in the order in which they
+     are packed and unpacked, so that mpiredist only has to gather,
+     exchange and scatter. The plan takes O(p) memory for the counts
+     and one int per local element on both sides.
+  */
+
+  void mpiredist_index(int m, int n, int M, int N, int s, int t, int br,
+                       int bc, int Mo, int No, int bro, int bco, int *rank,
+                       int p, int *count, int *displ, int *idx);
+  int nloc(int p, int s, int n, int b);
+  int p, q, dims[4], dims_glob[4], me[2], *all, *rank1, *rank2;
+  struct mpiredist *plan;
+
+  MPI_Comm_size(comm, &p);
+
+  /****** Superstep 0. Make the grids known to all processors ******/
+  dims[0] = (grid1 != NULL ? grid1->M : 0);
+  dims[1] = (grid1 != NULL ? grid1->N : 0);
+  dims[2] = (grid2 != NULL ? grid2->M : 0);
+  dims[3] = (grid2 != NULL ? grid2->N : 0);
+  MPI_Allreduce(dims, dims_glob, 4, MPI_INT, MPI_MAX, comm);
+  if (dims_glob[0] * dims_glob[1] == 0 || dims_glob[2] * dims_glob[3] == 0)
+    MPI_Abort(MPI_COMM_WORLD, -5);
+
+  me[0] = (grid1 != NULL ? grid1->s + grid1->t * grid1->M : -1);
+  me[1] = (grid2 != NULL ? grid2->s + grid2->t * grid2->M : -1);
+  all = vecalloci(2 * p);
+  MPI_Allgather(me, 2, MPI_INT, all, 2, MPI_INT, comm);
+
+  rank1 = vecalloci(dims_glob[0] * dims_glob[1]);
+  rank2 = vecalloci(dims_glob[2] * dims_glob[3]);
+  for (q = 0; q < p; q++) {
+    if (all[2 * q] >= 0)
+      rank1[all[2 * q]] = q;
+    if (all[2 * q + 1] >= 0)
+      rank2[all[2 * q + 1]] = q;
+  }
+
+  /****** Superstep 1. Compute the plan locally ******/
+  plan = (struct mpiredist *)malloc(sizeof(struct mpiredist));
+  if (plan == NULL)
+    MPI_Abort(MPI_COMM_WORLD, -13);
+  plan->comm = comm;
+  plan->scount = vecalloci(p);
+  plan->sdispl = vecalloci(p);
+  plan->rcount = vecalloci(p);
+  plan->rdispl = vecalloci(p);
+
+  if (grid1 != NULL) {
+    plan->nsend = nloc(grid1->M, grid1->s, m, br1) *
+                  nloc(grid1->N, grid1->t, n, bc1);
+    plan->sidx = vecalloci(plan->nsend);
+    mpiredist_index(m, n, grid1->M, grid1->N, grid1->s, grid1->t, br1, bc1,
+                    dims_glob[2], dims_glob[3], br2, bc2, rank2, p,
+                    plan->scount, plan->sdispl, plan->sidx);
+  } else {
+    plan->nsend = 0;
+    plan->sidx = NULL;
+    for (q = 0; q < p; q++)
+      plan->scount[q] = plan->sdispl[q] = 0;
+  }
+
+  if (grid2 != NULL) {
+    plan->nrecv = nloc(grid2->M, grid2->s, m, br2) *
+                  nloc(grid2->N, grid2->t, n, bc2);
+    plan->ridx = vecalloci(plan->nrecv);
+    mpiredist_index(m, n, grid2->M, grid2->N, grid2->s, grid2->t, br2, bc2,
+                    dims_glob[0], dims_glob[1], br1, bc1, rank1, p,
+                    plan->rcount, plan->rdispl, plan->ridx);
+  } else {
+    plan->nrecv = 0;
+    plan->ridx = NULL;
+    for (q = 0; q < p; q++)
+      plan->rcount[q] = plan->rdispl[q] = 0;
+  }
+
+  plan->sbuf = vecallocd(plan->nsend);
+  plan->rbuf = vecallocd(plan->nrecv);
+
+  vecfreei(rank2);
+  vecfreei(rank1);
+  vecfreei(all);
+
+  return plan;
+
+} /* end mpiredist_create */
+
+void mpiredist(struct mpiredist *plan, double **a1, double **a2) {
+  /* Move the matrix with local part a1 in the source distribution
+     of plan to the local part a2 in the destination distribution.
+     The local parts must have been allocated by matallocd, so that
+     they are contiguous; a processor that is not part of a grid
+     may pass NULL for its local part.
+     All processors of the communicator of plan must call this
+     function. The matrix is moved in one superstep, in which
+     every processor sends and receives at most the size of its
+     local part in the source and destination distribution.
+  */
+
+  int e;
+
+  for (e = 0; e < plan->nsend; e++)
+    plan->sbuf[e] = a1[0][plan->sidx[e]];
+
+  MPI_Alltoallv(plan->sbuf, plan->scount, plan->sdispl, MPI_DOUBLE,
+                plan->rbuf, plan->rcount, plan->rdispl, MPI_DOUBLE,
+                plan->comm);
+
+  for (e = 0; e < plan->nrecv; e++)
+    a2[0][plan->ridx[e]] = plan->rbuf[e];
+
+} /* end mpiredist */
+
+void mpiredist_free(struct mpiredist *plan) {
+  /* Free the plan created by mpiredist_create */
+
+  vecfreed(plan->rbuf);
+  vecfreed(plan->sbuf);
+  vecfreei(plan->ridx);
+  vecfreei(plan->sidx);
+  vecfreei(plan->rdispl);
+  vecfreei(plan->rcount);
+  vecfreei(plan->sdispl);
+  vecfreei(plan->scount);
+  free(plan);
+
+} /* end mpiredist_free */
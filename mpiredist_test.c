@@ -0,0 +1,187 @@
+#include "mpiedupack.h"
+#include "mpigrid.h"
+
+/*  This is a test program which uses mpiredist to move an m by n
+    matrix from an M1 by N1 grid with b1 by b1 blocks to an M2 by N2
+    grid with b2 by b2 blocks, and back. A block size 0 stands for
+    the block distribution, with ceil(m/M) by ceil(n/N) blocks.
+    Both grids are created from the first processors of MPI_COMM_WORLD,
+    so they may differ in size.
+
+    The matrix is moved NITERS times in each direction, after one run
+    to warm up, and the average time of a move and the rate of
+    8*m*n bytes per time are printed. Afterwards, the moved matrix
+    is compared with its definition from the global indices, and
+    the number of wrong elements on either grid is printed.
+*/
+
+#define NITERS 5
+
+double redistmat(int i, int j) {
+  /* Return the element (i,j) of the test matrix,
+     which is unique for every (i,j) */
+
+  return i * 65536.0 + j;
+
+} /* end redistmat */
+
+int main(int argc, char **argv) {
+
+  struct mpigrid *mpigrid_create(int M, int N, MPI_Comm comm);
+  void mpigrid_free(struct mpigrid *grid);
+  int nloc(int p, int s, int n, int b);
+  int gindex(int p, int s, int i, int b);
+  double redistmat(int i, int j);
+  struct mpiredist *mpiredist_create(int m, int n, struct mpigrid *grid1,
+                                     int br1, int bc1, struct mpigrid *grid2,
+                                     int br2, int bc2, MPI_Comm comm);
+  void mpiredist(struct mpiredist *plan, double **a1, double **a2);
+  void mpiredist_free(struct mpiredist *plan);
+  int p, pid, M1, N1, b1, M2, N2, b2, m, n, br1, bc1, br2, bc2, nlr1, nlc1,
+      nlr2, nlc2, iter, i, j, wrong, wrong_glob;
+  double **a1, **a2, time0, time1, timef, timeb, timep;
+  struct mpigrid *grid1, *grid2;
+  struct mpiredist *forw, *back;
+
+  MPI_Init(&argc, &argv);
+  MPI_Comm_size(MPI_COMM_WORLD, &p);
+  MPI_Comm_rank(MPI_COMM_WORLD, &pid);
+
+  if (pid == 0) {
+    printf("Please enter source grid M1 N1 and block size b1:\n");
+    scanf("%d %d %d", &M1, &N1, &b1);
+    if (M1 * N1 > p || b1 < 0)
+      MPI_Abort(MPI_COMM_WORLD, -5);
+    printf("Please enter destination grid M2 N2 and block size b2:\n");
+    scanf("%d %d %d", &M2, &N2, &b2);
+    if (M2 * N2 > p || b2 < 0)
+      MPI_Abort(MPI_COMM_WORLD, -5);
+    printf("Please enter matrix size m n:\n");
+    scanf("%d %d", &m, &n);
+    if (m < 1 || n < 1)
+      MPI_Abort(MPI_COMM_WORLD, -12);
+  }
+  MPI_Bcast(&M1, 1, MPI_INT, 0, MPI_COMM_WORLD);
+  MPI_Bcast(&N1, 1, MPI_INT, 0, MPI_COMM_WORLD);
+  MPI_Bcast(&b1, 1, MPI_INT, 0, MPI_COMM_WORLD);
+  MPI_Bcast(&M2, 1, MPI_INT, 0, MPI_COMM_WORLD);
+  MPI_Bcast(&N2, 1, MPI_INT, 0, MPI_COMM_WORLD);
+  MPI_Bcast(&b2, 1, MPI_INT, 0, MPI_COMM_WORLD);
+  MPI_Bcast(&m, 1, MPI_INT, 0, MPI_COMM_WORLD);
+  MPI_Bcast(&n, 1, MPI_INT, 0, MPI_COMM_WORLD);
+
+  br1 = (b1 > 0 ? b1 : (m + M1 - 1) / M1);
+  bc1 = (b1 > 0 ? b1 : (n + N1 - 1) / N1);
+  br2 = (b2 > 0 ? b2 : (m + M2 - 1) / M2);
+  bc2 = (b2 > 0 ? b2 : (n + N2 - 1) / N2);
+
+  grid1 = mpigrid_create(M1, N1, MPI_COMM_WORLD);
+  grid2 = mpigrid_create(M2, N2, MPI_COMM_WORLD);
+
+  a1 = a2 = NULL;
+  nlr1 = nlc1 = nlr2 = nlc2 = 0;
+  if (grid1 != NULL) {
+    nlr1 = nloc(M1, grid1->s, m, br1);
+    nlc1 = nloc(N1, grid1->t, n, bc1);
+    a1 = matallocd(nlr1, nlc1);
+  }
+  if (grid2 != NULL) {
+    nlr2 = nloc(M2, grid2->s, m, br2);
+    nlc2 = nloc(N2, grid2->t, n, bc2);
+    a2 = matallocd(nlr2, nlc2);
+  }
+
+  if (pid == 0) {
+    printf("Redistribution of a %d by %d matrix\n", m, n);
+    printf("from %d by %d grid with %d by %d blocks\n", M1, N1, br1, bc1);
+    printf("to %d by %d grid with %d by %d blocks\n", M2, N2, br2, bc2);
+  }
+
+  MPI_Barrier(MPI_COMM_WORLD);
+  time0 = MPI_Wtime();
+  forw = mpiredist_create(m, n, grid1, br1, bc1, grid2, br2, bc2,
+                          MPI_COMM_WORLD);
+  back = mpiredist_create(m, n, grid2, br2, bc2, grid1, br1, bc1,
+                          MPI_COMM_WORLD);
+  MPI_Barrier(MPI_COMM_WORLD);
+  time1 = MPI_Wtime();
+  timep = (time1 - time0) / 2.0;
+
+  timef = timeb = 0.0;
+  for (iter = 0; iter <= NITERS; iter++) {
+    for (i = 0; i < nlr1; i++) {
+      for (j = 0; j < nlc1; j++)
+        a1[i][j] = redistmat(gindex(M1, grid1->s, i, br1),
+                             gindex(N1, grid1->t, j, bc1));
+    }
+    for (i = 0; i < nlr2; i++) {
+      for (j = 0; j < nlc2; j++)
+        a2[i][j] = -1.0;
+    }
+
+    MPI_Barrier(MPI_COMM_WORLD);
+    time0 = MPI_Wtime();
+    mpiredist(forw, a1, a2);
+    MPI_Barrier(MPI_COMM_WORLD);
+    time1 = MPI_Wtime();
+    if (iter > 0)
+      timef += (time1 - time0) / NITERS;
+
+    for (i = 0; i < nlr1; i++) {
+      for (j = 0; j < nlc1; j++)
+        a1[i][j] = -1.0;
+    }
+
+    MPI_Barrier(MPI_COMM_WORLD);
+    time0 = MPI_Wtime();
+    mpiredist(back, a2, a1);
+    MPI_Barrier(MPI_COMM_WORLD);
+    time1 = MPI_Wtime();
+    if (iter > 0)
+      timeb += (time1 - time0) / NITERS;
+  }
+
+  if (pid == 0) {
+    printf("Creating a plan took %.6lf seconds.\n", timep);
+    printf("Moving forward took %.6lf seconds, rate = %.3lf GB/s\n", timef,
+           8.0 * m * (double)n / (timef * 1.0e9));
+    printf("Moving back took %.6lf seconds, rate = %.3lf GB/s\n", timeb,
+           8.0 * m * (double)n / (timeb * 1.0e9));
+  }
+
+  /* Check both copies of the matrix */
+  wrong = 0;
+  for (i = 0; i < nlr1; i++) {
+    for (j = 0; j < nlc1; j++) {
+      if (a1[i][j] != redistmat(gindex(M1, grid1->s, i, br1),
+                                gindex(N1, grid1->t, j, bc1)))
+        wrong++;
+    }
+  }
+  for (i = 0; i < nlr2; i++) {
+    for (j = 0; j < nlc2; j++) {
+      if (a2[i][j] != redistmat(gindex(M2, grid2->s, i, br2),
+                                gindex(N2, grid2->t, j, bc2)))
+        wrong++;
+    }
+  }
+  MPI_Reduce(&wrong, &wrong_glob, 1, MPI_INT, MPI_SUM, 0, MPI_COMM_WORLD);
+  if (pid == 0)
+    printf("Number of wrong elements = %d\n", wrong_glob);
+
+  mpiredist_free(back);
+  mpiredist_free(forw);
+  if (grid2 != NULL) {
+    matfreed(a2);
+    mpigrid_free(grid2);
+  }
+  if (grid1 != NULL) {
+    matfreed(a1);
+    mpigrid_free(grid1);
+  }
+
+  MPI_Finalize();
+
+  exit(0);
+
+} /* end main */
@@ -0,0 +1,223 @@
+#include "mpiedupack.h"
+
+/*  This program measures the synchronisation cost l of the
+    different MPI one-sided (RMA) synchronisation modes:
+        fence     MPI_Win_fence before and after the puts,
+        pscw      post-start-complete-wait with the neighbours,
+        lockall   passive target: MPI_Win_lock_all once,
+                  MPI_Win_flush_all and MPI_Barrier in every superstep,
+        ibarrier  passive target: MPI_Win_lock_all once,
+                  MPI_Win_flush_all and MPI_Ibarrier in every superstep.
+    In every superstep each processor puts one double into each of
+    nw windows of its right neighbour, so that the superstep really
+    has to deliver data. The cost is measured for nw = 1, ..., MAXWIN
+    windows, since mpimv_init synchronises four windows in a row,
+    and for the first q processors, q = 1, 2, 4, ..., p.
+
+    Next to it, the collective-based l of the h-relation test of
+    mpibench is given, obtained by a least-squares fit of the time
+    of h-relations with 0 <= h <= q, performed by MPI_Alltoallv.
+    All times are in microseconds per superstep.
+*/
+
+#define NITERS 100 /* number of iterations */
+#define MAXWIN 4   /* maximum number of windows */
+#define MICRO 1000000.0
+
+#define FENCE 0
+#define PSCW 1
+#define LOCKALL 2
+#define IBARRIER 3
+#define NMODES 4
+
+double synctime(int mode, int nw, int q, int s, MPI_Comm comm) {
+  /* This function returns the time in seconds of one superstep
+     in which processor s puts one double into each of the nw
+     windows of processor s+1 mod q, using synchronisation mode mode.
+     comm contains the q participating processors. */
+
+  int w, iter, left, right;
+  double src, dest[MAXWIN], time0, time1, time, maxtime;
+
+  MPI_Win win[MAXWIN];
+  MPI_Group group, leftgroup, rightgroup;
+  MPI_Request request;
+
+  left = (s - 1 + q) % q;
+  right = (s + 1) % q;
+  src = (double)s;
+
+  for (w = 0; w < nw; w++)
+    MPI_Win_create(&dest[w], SZDBL, SZDBL, MPI_INFO_NULL, comm, &win[w]);
+  MPI_Comm_group(comm, &group);
+  MPI_Group_incl(group, 1, &left, &leftgroup);
+  MPI_Group_incl(group, 1, &right, &rightgroup);
+
+  if (mode == LOCKALL || mode == IBARRIER) {
+    for (w = 0; w < nw; w++)
+      MPI_Win_lock_all(0, win[w]);
+  }
+  if (mode == FENCE) {
+    for (w = 0; w < nw; w++)
+      MPI_Win_fence(0, win[w]);
+  }
+
+  MPI_Barrier(comm);
+  time0 = MPI_Wtime();
+  for (iter = 0; iter < NITERS; iter++) {
+    if (mode == FENCE) {
+      for (w = 0; w < nw; w++)
+        MPI_Put(&src, 1, MPI_DOUBLE, right, 0, 1, MPI_DOUBLE, win[w]);
+      for (w = 0; w < nw; w++)
+        MPI_Win_fence(0, win[w]);
+    } else if (mode == PSCW) {
+      for (w = 0; w < nw; w++) {
+        MPI_Win_post(leftgroup, 0, win[w]);
+        MPI_Win_start(rightgroup, 0, win[w]);
+      }
+      for (w = 0; w < nw; w++)
+        MPI_Put(&src, 1, MPI_DOUBLE, right, 0, 1, MPI_DOUBLE, win[w]);
+      for (w = 0; w < nw; w++) {
+        MPI_Win_complete(win[w]);
+        MPI_Win_wait(win[w]);
+      }
+    } else {
+      for (w = 0; w < nw; w++)
+        MPI_Put(&src, 1, MPI_DOUBLE, right, 0, 1, MPI_DOUBLE, win[w]);
+      for (w = 0; w < nw; w++)
+        MPI_Win_flush_all(win[w]);
+      if (mode == LOCKALL) {
+        MPI_Barrier(comm);
+      } else {
+        MPI_Ibarrier(comm, &request);
+        MPI_Wait(&request, MPI_STATUS_IGNORE);
+      }
+    }
+  }
+  time1 = MPI_Wtime();
+  time = (time1 - time0) / NITERS;
+  MPI_Allreduce(&time, &maxtime, 1, MPI_DOUBLE, MPI_MAX, comm);
+
+  if (mode == LOCKALL || mode == IBARRIER) {
+    for (w = 0; w < nw; w++)
+      MPI_Win_unlock_all(win[w]);
+  }
+  MPI_Group_free(&rightgroup);
+  MPI_Group_free(&leftgroup);
+  MPI_Group_free(&group);
+  for (w = nw - 1; w >= 0; w--)
+    MPI_Win_free(&win[w]);
+
+  return maxtime;
+
+} /* end synctime */
+
+double hrelation_l(int q, int s, MPI_Comm comm) {
+  /* This function returns the collective-based synchronisation cost l
+     in seconds, obtained as in mpibench from the time of h-relations
+     with 0 <= h <= q performed by MPI_Alltoallv on the q processors
+     of comm. */
+
+  int h, i, s1, iter, *Nsend, *Nrecv, *Offset_send, *Offset_recv;
+  double time0, time1, g, l, *src, *dest, *t;
+
+  Nsend = vecalloci(q);
+  Nrecv = vecalloci(q);
+  Offset_send = vecalloci(q);
+  Offset_recv = vecalloci(q);
+  src = vecallocd(q);
+  dest = vecallocd(q);
+  t = vecallocd(q + 1);
+
+  for (h = 0; h <= q; h++) {
+    for (i = 0; i < h; i++)
+      src[i] = (double)i;
+
+    if (q == 1) {
+      Nsend[0] = Nrecv[0] = h;
+    } else {
+      for (s1 = 0; s1 < q; s1++)
+        Nsend[s1] = Nrecv[s1] = h / (q - 1);
+      for (i = 0; i < h % (q - 1); i++) {
+        Nsend[(s + 1 + i) % q]++;
+        Nrecv[(s - 1 - i + q) % q]++;
+      }
+      Nsend[s] = Nrecv[s] = 0;
+    }
+    Offset_send[0] = Offset_recv[0] = 0;
+    for (s1 = 1; s1 < q; s1++) {
+      Offset_send[s1] = Offset_send[s1 - 1] + Nsend[s1 - 1];
+      Offset_recv[s1] = Offset_recv[s1 - 1] + Nrecv[s1 - 1];
+    }
+
+    MPI_Barrier(comm);
+    time0 = MPI_Wtime();
+    for (iter = 0; iter < NITERS; iter++) {
+      MPI_Alltoallv(src, Nsend, Offset_send, MPI_DOUBLE, dest, Nrecv,
+                    Offset_recv, MPI_DOUBLE, comm);
+      MPI_Barrier(comm);
+    }
+    time1 = MPI_Wtime();
+    t[h] = (time1 - time0) / NITERS;
+  }
+  leastsquares(0, q, t, &g, &l);
+
+  vecfreed(t);
+  vecfreed(dest);
+  vecfreed(src);
+  vecfreei(Offset_recv);
+  vecfreei(Offset_send);
+  vecfreei(Nrecv);
+  vecfreei(Nsend);
+
+  return l;
+
+} /* end hrelation_l */
+
+int main(int argc, char **argv) {
+  double synctime(int mode, int nw, int q, int s, MPI_Comm comm);
+  double hrelation_l(int q, int s, MPI_Comm comm);
+  int p, s, q, nw, mode;
+  double l[NMODES], lh;
+
+  MPI_Comm comm;
+
+  MPI_Init(&argc, &argv);
+
+  MPI_Comm_size(MPI_COMM_WORLD, &p); /* p = number of processors */
+  MPI_Comm_rank(MPI_COMM_WORLD, &s); /* s = processor number */
+
+  if (s == 0) {
+    printf("Synchronisation cost l in microseconds per superstep\n");
+    printf("    q  nw     fence      pscw   lockall  ibarrier  "
+           "h-relation\n");
+    fflush(stdout);
+  }
+
+  for (q = 1; q <= p; q = (q < p && 2 * q > p ? p : 2 * q)) {
+    /* The first q processors take part, the others wait */
+    MPI_Comm_split(MPI_COMM_WORLD, (s < q ? 0 : MPI_UNDEFINED), s, &comm);
+    if (s < q) {
+      lh = hrelation_l(q, s, comm);
+      for (nw = 1; nw <= MAXWIN; nw++) {
+        for (mode = 0; mode < NMODES; mode++)
+          l[mode] = synctime(mode, nw, q, s, comm);
+        if (s == 0) {
+          printf("%5d %3d %9.2lf %9.2lf %9.2lf %9.2lf   %9.2lf\n", q, nw,
+                 l[FENCE] * MICRO, l[PSCW] * MICRO, l[LOCKALL] * MICRO,
+                 l[IBARRIER] * MICRO, lh * MICRO);
+          fflush(stdout);
+        }
+      }
+      MPI_Comm_free(&comm);
+    }
+    MPI_Barrier(MPI_COMM_WORLD);
+    if (q == p)
+      break;
+  }
+
+  MPI_Finalize();
+
+  exit(0);
+
+} /* end main */